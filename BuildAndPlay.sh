@@ -2,9 +2,9 @@
 #
 # Build gambit and play a game...
 #
-#
+# The game runs the build itself and reads its output straight from pipes;
+# closing the game (or the 100 s timeout) stops the build and all its jobs.
 #
 
-./game stderr.log stdout.log &
-timeout 100 bash compile_gambit.sh 2>stderr.log 1>stdout.log
+./game --build "bash compile_gambit.sh" --build-timeout 100
 
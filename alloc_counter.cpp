@@ -0,0 +1,43 @@
+#include "alloc_counter.h"
+
+#ifdef GAME_COUNT_ALLOCS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> allocationCount{0};
+
+static void* countedAlloc(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    if (void* p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size) { return countedAlloc(size); }
+void* operator new[](std::size_t size) { return countedAlloc(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+bool allocationCountingEnabled() {
+    return true;
+}
+
+uint64_t heapAllocationCount() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool allocationCountingEnabled() {
+    return false;
+}
+
+uint64_t heapAllocationCount() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+
+// Debug counter of global operator new calls, used to check that the main
+// loop stops allocating once it reaches steady state. Only active in builds
+// made with ALLOC_COUNTER=1 (which defines GAME_COUNT_ALLOCS); otherwise it
+// always reads zero.
+bool allocationCountingEnabled();
+uint64_t heapAllocationCount();
+
+#endif
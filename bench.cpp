@@ -0,0 +1,311 @@
+#include "classifier.h"
+#include "font.h"
+#include "ingest.h"
+#include "log_reader.h"
+#include "simulation.h"
+#include "text_store.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Micro-benchmarks for the per-frame hot paths. Results are written as JSON
+// (default) or CSV so runs can be diffed and checked for regressions.
+
+struct BenchResult {
+    std::string name;
+    std::string param;
+    uint64_t iterations;
+    double nsPerOp;
+};
+
+static double minBenchSeconds = 0.25;
+static std::string benchFilter;
+static std::vector<BenchResult> results;
+
+// Keeps the optimiser from discarding benchmarked work
+static volatile double benchSink = 0.0;
+
+template <typename Fn>
+static void runBench(const std::string& name, const std::string& param, Fn&& fn) {
+    if (!benchFilter.empty() && name.find(benchFilter) == std::string::npos) return;
+
+    using Clock = std::chrono::steady_clock;
+    fn();  // warm up
+
+    uint64_t iterations = 0;
+    uint64_t batch = 1;
+    double elapsed = 0.0;
+    auto start = Clock::now();
+    while (elapsed < minBenchSeconds) {
+        for (uint64_t i = 0; i < batch; i++) fn();
+        iterations += batch;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        if (elapsed < minBenchSeconds / 10.0) batch *= 2;
+    }
+
+    results.push_back({ name, param, iterations, elapsed * 1e9 / iterations });
+    std::cerr << name << " [" << param << "]: " << results.back().nsPerOp << " ns/op" << std::endl;
+}
+
+static std::string makeLine(size_t length) {
+    static const char pattern[] = "src/ModelBit/models.cpp:123: warning: unused variable 'x' ";
+    std::string line;
+    while (line.size() < length) line += pattern;
+    line.resize(length);
+    return line;
+}
+
+static std::string writeSyntheticLog(size_t bytes) {
+    std::string path = "/tmp/game_bench_" + std::to_string(bytes) + ".log";
+    std::ofstream out(path, std::ios::binary);
+    size_t written = 0;
+    for (size_t i = 0; written < bytes; i++) {
+        std::string line = (i % 50 == 0) ? "// comment line" : makeLine(40 + (i * 37) % 120);
+        out << line << '\n';
+        written += line.size() + 1;
+    }
+    return path;
+}
+
+static void benchText() {
+    const size_t lengths[] = { 16, 120, 2000 };
+    for (size_t length : lengths) {
+        std::string text = makeLine(length);
+        std::string param = std::to_string(length) + "_chars";
+
+        runBench("getTextWidth", param, [&] {
+            benchSink = benchSink + getTextWidth(text, 0.5f);
+        });
+
+        // Collision uses the bounds cached at spawn, so its cost should not
+        // depend on the text length any more
+        float width = getTextWidth(text, 0.5f);
+        float height = getTextHeight(0.5f);
+        runBench("checkCollision", param, [&] {
+            benchSink = benchSink + checkCollision(0.0f, -0.7f, 0.05f, 150.0f, 180.0f, width, height);
+        });
+
+        std::vector<float> vertices;
+        vertices.reserve(length * 6 * TEXT_VERTEX_FLOATS);
+        runBench("appendTextQuads", param, [&] {
+            vertices.clear();
+            appendTextQuads(vertices, text, 150.0f, 400.0f, 0.5f, 1.0f, 0.0f, 0.0f);
+            benchSink = benchSink + vertices.size();
+        });
+    }
+}
+
+static void benchLogReading() {
+    const size_t sizes[] = { 1u << 20, 100u << 20 };
+    for (size_t size : sizes) {
+        std::string path = writeSyntheticLog(size);
+        std::string param = std::to_string(size >> 20) + "MB";
+
+        runBench("readAllLines", param, [&] {
+            benchSink = benchSink + readAllLines(path).size();
+        });
+
+        runBench("MappedLog_drain", param, [&] {
+            MappedLog log(path);
+            std::string_view line;
+            size_t count = 0;
+            while (log.nextLine(line)) count++;
+            benchSink = benchSink + count;
+        });
+
+        std::remove(path.c_str());
+    }
+
+    // Cost of handing one line across the ingest ring (both ends on this
+    // thread, so no cache-line traffic is included)
+    LineRing ring(DEFAULT_INGEST_RING_LINES);
+    std::string line = makeLine(80);
+    runBench("LineRing_push_pop", "80_chars", [&] {
+        ring.push(line);
+        std::string_view out;
+        ring.front(out);
+        ring.pop();
+        benchSink = benchSink + out.size();
+    });
+}
+
+static void benchClassifier() {
+    // A mix shaped like a parallel C++ build: mostly progress and warnings
+    // with the odd note and error, cycled so lengths vary
+    const std::vector<std::string> lines = {
+        "[ 42%] Building CXX object ModelBit/CMakeFiles/ModelBit.dir/src/models.cpp.o",
+        makeLine(120),
+        "/src/ModelBit/include/models.hpp:88:12: note: in instantiation of function template requested here",
+        "/src/DarkBit/src/DarkBit.cpp:1021:5: error: use of undeclared identifier 'foo'",
+        "make[2]: *** [DarkBit/CMakeFiles/DarkBit.dir/build.make:76: DarkBit.o] Error 1",
+        "-- Found Boost: /usr/include (found suitable version \"1.74.0\")",
+        makeLine(40),
+        "Scanning dependencies of target ScannerBit",
+    };
+    LineClassifier classifier;
+    size_t next = 0;
+    runBench("classify", std::to_string(classifier.stateCount()) + "_states", [&] {
+        benchSink = benchSink + static_cast<int>(classifier.classify(lines[next], TextCategory::Other));
+        next = next + 1 == lines.size() ? 0 : next + 1;
+    });
+}
+
+static void benchFallingTexts() {
+    const size_t counts[] = { 10, 1000, 100000 };
+    const float spawnY = 850.0f;
+    const float speed = 50.0f;
+    std::string line = makeLine(80);
+    float width = getTextWidth(line, 0.5f);
+    float height = getTextHeight(0.5f);
+
+    for (size_t count : counts) {
+        // Spread texts evenly down the screen and pick the timestep so that
+        // exactly one falls off per frame while one new one spawns.
+        TextStore texts(count + 1);
+        for (size_t i = 0; i < count; i++) {
+            texts.spawn(line, TextCategory::Error, 0, 150.0f, spawnY * (i + 0.5f) / count, speed, width, height);
+        }
+        float deltaTime = spawnY / count / speed;
+
+        runBench("fallingTexts_cycle", std::to_string(count) + "_texts", [&] {
+            texts.spawn(line, TextCategory::Other, 0, 150.0f, spawnY, speed, width, height);
+            texts.integrate(deltaTime);
+            texts.removeBelow(0.0f);
+            benchSink = benchSink + texts.size();
+        });
+
+        // Player-vs-texts collision pass: every text against the player,
+        // versus only the texts the y broadphase hands back
+        const Aabb playerBox = { 540.0f, 660.0f, 150.0f, 210.0f };
+        std::vector<uint32_t> hitIndices(texts.size());
+        runBench("collision_all", std::to_string(count) + "_texts", [&] {
+            benchSink = benchSink + collideAabb(texts.x.data(), texts.y.data(), texts.width.data(),
+                                                texts.height.data(), texts.size(), playerBox, hitIndices.data());
+        });
+        runBench("collision_broadphase", std::to_string(count) + "_texts", [&] {
+            std::pair<size_t, size_t> band = texts.band(playerBox.minY, playerBox.maxY, height);
+            benchSink = benchSink + collideAabb(texts.x.data() + band.first, texts.y.data() + band.first,
+                                                texts.width.data() + band.first, texts.height.data() + band.first,
+                                                band.second - band.first, playerBox, hitIndices.data());
+        });
+    }
+}
+
+// The array-of-structs layout FallingText used before TextStore, kept here
+// as the baseline for the layout benchmarks
+struct AosText {
+    std::string text;
+    TextCategory category;
+    float x, y, speed;
+    float r, g, b;
+    float width, height;
+};
+
+static void benchTextLayouts() {
+    const size_t counts[] = { 10000, 100000 };
+    const Aabb playerBox = { 540.0f, 660.0f, 150.0f, 210.0f };
+    std::string line = makeLine(80);
+    float width = getTextWidth(line, 0.5f);
+    float height = getTextHeight(0.5f);
+
+    for (size_t count : counts) {
+        std::string param = std::to_string(count) + "_texts";
+        std::vector<AosText> aos;
+        TextStore soa(count);
+        for (size_t i = 0; i < count; i++) {
+            // Mixed speeds so the update really has to write every entry
+            float y = 850.0f * (i + 0.5f) / count;
+            float speed = 40.0f + (i % 3) * 10.0f;
+            aos.push_back({ line, TextCategory::Error, 150.0f + (i % 7) * 60.0f, y, speed,
+                            1.0f, 0.0f, 0.0f, width, height });
+            soa.spawn(line, TextCategory::Error, 0, 150.0f + (i % 7) * 60.0f, y, speed, width, height);
+        }
+        std::vector<uint32_t> hitIndices(count);
+
+        // Update then a full (no broadphase) collision pass, per layout. The
+        // timestep is tiny so the positions barely drift between iterations.
+        const float deltaTime = 1e-6f;
+        runBench("layout_aos", param, [&] {
+            for (auto& text : aos) text.y -= text.speed * deltaTime;
+            size_t hits = 0;
+            for (const auto& text : aos) {
+                hits += playerBox.minX < text.x + text.width && playerBox.maxX > text.x &&
+                        playerBox.minY < text.y + text.height && playerBox.maxY > text.y;
+            }
+            benchSink = benchSink + hits;
+        });
+
+        auto soaPass = [&] {
+            integratePositions(soa.y.data(), soa.speed.data(), soa.size(), deltaTime);
+            benchSink = benchSink + collideAabb(soa.x.data(), soa.y.data(), soa.width.data(),
+                                                soa.height.data(), soa.size(), playerBox, hitIndices.data());
+        };
+        useScalarTextKernels(true);
+        runBench("layout_soa_scalar", param, soaPass);
+        useScalarTextKernels(false);
+        runBench(std::string("layout_soa_") + textKernelName(), param, soaPass);
+    }
+}
+
+static void writeResults(std::ostream& out, const std::string& format) {
+    if (format == "csv") {
+        out << "name,param,iterations,ns_per_op" << std::endl;
+        for (const auto& r : results) {
+            out << r.name << ',' << r.param << ',' << r.iterations << ',' << r.nsPerOp << std::endl;
+        }
+        return;
+    }
+
+    out << "[" << std::endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto& r = results[i];
+        out << "  {\"name\": \"" << r.name << "\", \"param\": \"" << r.param
+            << "\", \"iterations\": " << r.iterations << ", \"ns_per_op\": " << r.nsPerOp << "}"
+            << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    out << "]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string format = "json";
+    std::string outPath;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc) {
+            format = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (arg == "--filter" && i + 1 < argc) {
+            benchFilter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            minBenchSeconds = std::atof(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--format json|csv] [--out FILE] [--filter NAME] [--min-time SECONDS]" << std::endl;
+            return -1;
+        }
+    }
+
+    if (!glyphCache.open(FONT_PATH, FONT_PIXEL_HEIGHT)) {
+        return -1;
+    }
+
+    benchText();
+    benchLogReading();
+    benchClassifier();
+    benchFallingTexts();
+    benchTextLayouts();
+
+    if (outPath.empty()) {
+        writeResults(std::cout, format);
+    } else {
+        std::ofstream out(outPath);
+        writeResults(out, format);
+    }
+    return 0;
+}
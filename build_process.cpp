@@ -0,0 +1,159 @@
+#include "build_process.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <signal.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+// How long the build gets to exit after SIGTERM before it is killed
+static const double terminateGraceSeconds = 2.0;
+
+static double monotonicSeconds() {
+    using Clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+}
+
+BuildProcess::~BuildProcess() {
+    stop();
+}
+
+bool BuildProcess::start(const std::string& command, double timeoutSeconds) {
+    int errPipe[2];
+    int outPipe[2];
+    if (pipe2(errPipe, O_CLOEXEC) != 0) {
+        std::cerr << "Failed to create build pipes: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (pipe2(outPipe, O_CLOEXEC) != 0) {
+        std::cerr << "Failed to create build pipes: " << std::strerror(errno) << std::endl;
+        ::close(errPipe[0]);
+        ::close(errPipe[1]);
+        return false;
+    }
+
+#ifdef __linux__
+    // Jobs the shell leaves behind are reparented to the game rather than
+    // to init, so they are reaped here and the group can be seen to be gone
+    prctl(PR_SET_CHILD_SUBREAPER, 1);
+#endif
+
+    pid_t child = fork();
+    if (child < 0) {
+        std::cerr << "Failed to start build: " << std::strerror(errno) << std::endl;
+        for (int fd : { errPipe[0], errPipe[1], outPipe[0], outPipe[1] }) ::close(fd);
+        return false;
+    }
+
+    if (child == 0) {
+        // Own process group, so the game can signal the build and everything
+        // it spawned in one go. Only async-signal-safe calls from here on.
+        setpgid(0, 0);
+#ifdef __linux__
+        // If the game dies without cleaning up, at least the shell goes
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+        int devNull = ::open("/dev/null", O_RDONLY);
+        if (devNull >= 0) dup2(devNull, STDIN_FILENO);
+        dup2(outPipe[1], STDOUT_FILENO);
+        dup2(errPipe[1], STDERR_FILENO);
+        execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+
+    // Also set from this side so the group exists before we could signal it
+    setpgid(child, child);
+    ::close(errPipe[1]);
+    ::close(outPipe[1]);
+
+    pid = child;
+    group = child;
+    status = 0;
+    startTime = monotonicSeconds();
+    timeout = timeoutSeconds;
+    termSentAt = -1.0;
+    stderrSource = std::make_unique<PipeSource>(errPipe[0]);
+    stdoutSource = std::make_unique<PipeSource>(outPipe[0]);
+    return true;
+}
+
+void BuildProcess::signalGroup(int signal) {
+    if (group > 0) kill(-group, signal);
+}
+
+bool BuildProcess::reap(bool wait) {
+    if (pid <= 0) return true;
+    pid_t result = waitpid(pid, &status, wait ? 0 : WNOHANG);
+    if (result == pid || (result < 0 && errno == ECHILD)) {
+        pid = -1;
+        endTime = monotonicSeconds();
+        return true;
+    }
+    return false;
+}
+
+bool BuildProcess::groupAlive() {
+    if (group <= 0) return false;
+    // Exited jobs still count as members until they are reaped. The shell's
+    // status is reap()'s to collect, so only do this once it has gone.
+    if (pid <= 0) {
+        int jobStatus;
+        while (waitpid(-group, &jobStatus, WNOHANG) > 0) {
+        }
+    }
+    if (kill(-group, 0) != 0 && errno == ESRCH) {
+        group = -1;
+        return false;
+    }
+    return true;
+}
+
+double BuildProcess::elapsedSeconds() const {
+    return (running() ? monotonicSeconds() : endTime) - startTime;
+}
+
+void BuildProcess::update() {
+    reap(false);
+    if (group <= 0) return;
+
+    double now = monotonicSeconds();
+    if (timeout > 0.0 && termSentAt < 0.0 && now - startTime >= timeout) {
+        if (!groupAlive()) return;
+        std::cerr << "Build timed out after " << timeout << " s; stopping it" << std::endl;
+        signalGroup(SIGTERM);
+        termSentAt = now;
+    } else if (termSentAt >= 0.0) {
+        // The shell goes at the first signal; keep on at the jobs it started
+        if (!groupAlive()) return;
+        if (now - termSentAt >= terminateGraceSeconds) signalGroup(SIGKILL);
+    }
+}
+
+void BuildProcess::stop() {
+    reap(false);
+    if (!groupAlive()) return;
+
+    signalGroup(SIGTERM);
+    double killAt = monotonicSeconds() + terminateGraceSeconds;
+    // SIGKILL can't be ignored, but a job stuck in the kernel won't go
+    // until it returns; don't hang the game's exit on it forever
+    double giveUpAt = killAt + terminateGraceSeconds;
+    for (;;) {
+        reap(false);
+        if (!groupAlive()) return;
+        double now = monotonicSeconds();
+        if (now >= giveUpAt) {
+            std::cerr << "Build process group " << group << " is still there after SIGKILL" << std::endl;
+            return;
+        }
+        if (now >= killAt) signalGroup(SIGKILL);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
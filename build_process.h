@@ -0,0 +1,67 @@
+#ifndef BUILD_PROCESS_H
+#define BUILD_PROCESS_H
+
+#include "log_reader.h"
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+// Runs a build command under /bin/sh in its own process group with stdout
+// and stderr on pipes, so its output can be fed to the lanes directly
+// instead of round-tripping through log files. Everything the command
+// starts (make and its compiler jobs included) shares the group, so
+// stopping the build signals the whole group and nothing is left behind.
+class BuildProcess {
+public:
+    BuildProcess() = default;
+    ~BuildProcess();
+
+    BuildProcess(const BuildProcess&) = delete;
+    BuildProcess& operator=(const BuildProcess&) = delete;
+
+    // Starts command. timeoutSeconds <= 0 means no time limit. Returns false
+    // (after printing why) if the pipes or the process can't be created.
+    bool start(const std::string& command, double timeoutSeconds);
+
+    // The read ends of the child's stderr and stdout. Each can be taken once.
+    std::unique_ptr<PipeSource> takeStderr() { return std::move(stderrSource); }
+    std::unique_ptr<PipeSource> takeStdout() { return std::move(stdoutSource); }
+
+    // Reaps the child if it has exited and enforces the timeout: SIGTERM to
+    // the group first, then SIGKILL after a grace period until every process
+    // in it has gone, not just the shell. Never blocks, so it can be called
+    // every frame, also after the shell has exited.
+    void update();
+
+    // Stops the whole group and waits (at most the grace period, then
+    // SIGKILL) for everything in it to go, jobs the shell left behind
+    // included.
+    void stop();
+
+    // Whether the shell running the command is still there
+    bool running() const { return pid > 0; }
+    // The build's process group, or -1 once everything in it has gone
+    pid_t processGroup() const { return group; }
+    // Wait status from waitpid, valid once running() is false after a start
+    int exitStatus() const { return status; }
+    // Wall-clock time from start to exit (or to now while it runs)
+    double elapsedSeconds() const;
+
+private:
+    void signalGroup(int signal);
+    bool reap(bool wait);
+    bool groupAlive();
+
+    pid_t pid = -1;
+    // Kept after the shell is reaped: make's jobs can outlive it
+    pid_t group = -1;
+    int status = 0;
+    double startTime = 0.0;
+    double endTime = 0.0;
+    double timeout = 0.0;
+    double termSentAt = -1.0;
+    std::unique_ptr<PipeSource> stderrSource;
+    std::unique_ptr<PipeSource> stdoutSource;
+};
+
+#endif
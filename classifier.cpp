@@ -0,0 +1,200 @@
+#include "classifier.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Marks the start of a line: '^' in a pattern becomes this byte, and
+// classify() feeds it before the line. It can't occur inside a line.
+static const unsigned char LINE_START = '\n';
+
+static const char* defaultPatternConfig = R"(
+# gcc / clang
+error    error:
+error    "fatal error"
+error    "undefined reference to"
+error    "ld returned"
+error    "multiple definition of"
+error    "Segmentation fault"
+warning  warning:
+note     note:
+note     "In file included from"
+note     "required from"
+note     "In instantiation of"
+
+# make / CMake
+error    "] Error "
+error    "CMake Error"
+error    "No rule to make target"
+warning  "CMake Warning"
+progress "%] "
+progress "^Scanning dependencies"
+progress "^Consolidate compiler generated dependencies"
+progress "^-- "
+)";
+
+std::vector<ClassifierPattern> defaultClassifierPatterns() {
+    std::vector<ClassifierPattern> patterns;
+    parseClassifierPatterns(defaultPatternConfig, patterns);
+    return patterns;
+}
+
+bool parseTextCategory(std::string_view name, TextCategory& category) {
+    if (name == "error") category = TextCategory::Error;
+    else if (name == "warning") category = TextCategory::Warning;
+    else if (name == "note") category = TextCategory::Note;
+    else if (name == "progress") category = TextCategory::Progress;
+    else if (name == "other") category = TextCategory::Other;
+    else return false;
+    return true;
+}
+
+bool parseClassifierPatterns(std::string_view config, std::vector<ClassifierPattern>& patterns) {
+    std::istringstream in{std::string(config)};
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#') continue;
+
+        size_t nameEnd = line.find_first_of(" \t", start);
+        size_t textStart = nameEnd == std::string::npos ? nameEnd : line.find_first_not_of(" \t", nameEnd);
+        size_t textEnd = line.find_last_not_of(" \t\r");
+        TextCategory category;
+        // "other" is what matching no pattern means, so no pattern can give it
+        if (textStart == std::string::npos ||
+            !parseTextCategory(std::string_view(line).substr(start, nameEnd - start), category) ||
+            category == TextCategory::Other) {
+            std::cerr << "ERROR::CLASSIFIER: Bad pattern on line " << lineNumber << ": " << line << std::endl;
+            return false;
+        }
+
+        std::string text = line.substr(textStart, textEnd + 1 - textStart);
+        if (text.size() >= 2 && text.front() == '"' && text.back() == '"') {
+            text = text.substr(1, text.size() - 2);
+        }
+        if (text.empty() || text == "^") {
+            std::cerr << "ERROR::CLASSIFIER: Empty pattern on line " << lineNumber << std::endl;
+            return false;
+        }
+        patterns.push_back({ category, text });
+    }
+    return true;
+}
+
+bool loadClassifierPatterns(const std::string& path, std::vector<ClassifierPattern>& patterns) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "ERROR::CLASSIFIER: Could not open " << path << std::endl;
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return parseClassifierPatterns(contents.str(), patterns);
+}
+
+uint64_t hashClassifierPatterns(const std::vector<ClassifierPattern>& patterns) {
+    // FNV-1a over each category and pattern, with a '\n' after each as the
+    // config file has
+    uint64_t hash = 0xCBF29CE484222325ull;
+    auto add = [&hash](unsigned char c) { hash = (hash ^ c) * 0x100000001B3ull; };
+    for (const ClassifierPattern& pattern : patterns) {
+        add(static_cast<unsigned char>(pattern.category));
+        for (char c : pattern.text) add(static_cast<unsigned char>(c));
+        add('\n');
+    }
+    return hash;
+}
+
+static TextCategory moreSevere(TextCategory a, TextCategory b) {
+    // Categories are declared most severe first
+    return static_cast<uint8_t>(a) < static_cast<uint8_t>(b) ? a : b;
+}
+
+LineClassifier::LineClassifier(const std::vector<ClassifierPattern>& patterns) {
+    std::vector<std::string> keys;
+    for (const auto& pattern : patterns) {
+        std::string key = pattern.text;
+        if (key[0] == '^') key[0] = static_cast<char>(LINE_START);
+        keys.push_back(key);
+    }
+
+    // Bytes that appear in no pattern all share class 0
+    for (const auto& key : keys) {
+        for (unsigned char c : key) {
+            if (byteClass[c] == 0) byteClass[c] = static_cast<uint16_t>(classCount++);
+        }
+    }
+    if (byteClass[LINE_START] == 0) byteClass[LINE_START] = static_cast<uint16_t>(classCount++);
+
+    // Trie of the patterns, with edges not in it marked missing
+    const uint32_t missing = 0xFFFFFFFFu;
+    std::vector<uint32_t> edges(classCount, missing);
+    output.assign(1, TextCategory::Other);
+    for (size_t p = 0; p < keys.size(); p++) {
+        uint32_t state = 0;
+        for (unsigned char c : keys[p]) {
+            uint32_t& edge = edges[state * classCount + byteClass[c]];
+            if (edge == missing) {
+                edge = static_cast<uint32_t>(output.size());
+                output.push_back(TextCategory::Other);
+                edges.resize(edges.size() + classCount, missing);
+            }
+            state = edges[state * classCount + byteClass[c]];
+        }
+        output[state] = moreSevere(output[state], patterns[p].category);
+    }
+
+    // Breadth-first over the trie: fill in every missing edge from the
+    // failure state, and merge each state's output with its failure state's
+    // so a match of any suffix is seen without following links at runtime
+    std::vector<uint32_t> fail(output.size(), 0);
+    std::vector<uint32_t> queue;
+    for (uint32_t c = 0; c < classCount; c++) {
+        uint32_t& edge = edges[c];
+        if (edge == missing) {
+            edge = 0;
+        } else {
+            queue.push_back(edge);
+        }
+    }
+    for (size_t q = 0; q < queue.size(); q++) {
+        uint32_t state = queue[q];
+        for (uint32_t c = 0; c < classCount; c++) {
+            uint32_t& edge = edges[state * classCount + c];
+            uint32_t viaFail = edges[fail[state] * classCount + c];
+            if (edge == missing) {
+                edge = viaFail;
+            } else {
+                fail[edge] = viaFail;
+                output[edge] = moreSevere(output[edge], output[viaFail]);
+                queue.push_back(edge);
+            }
+        }
+    }
+
+    // Pack each edge as the target's row offset with its output in the low
+    // bits, so the loop needs no second lookup to see what matched
+    next.resize(edges.size());
+    for (size_t i = 0; i < edges.size(); i++) {
+        next[i] = (edges[i] * classCount) << OUTPUT_BITS | static_cast<uint32_t>(output[edges[i]]);
+    }
+    start = next[byteClass[LINE_START]];
+}
+
+TextCategory LineClassifier::classify(std::string_view line, TextCategory fallback) const {
+    const uint32_t outputMask = (1u << OUTPUT_BITS) - 1;
+    uint32_t found = start & outputMask;
+    uint32_t edge = start;
+    for (unsigned char c : line) {
+        edge = next[(edge >> OUTPUT_BITS) + byteClass[c]];
+        uint32_t category = edge & outputMask;
+        // Lower is more severe, and Other (nothing matched) is the highest
+        if (category < found) {
+            found = category;
+            if (found == static_cast<uint32_t>(TextCategory::Error)) break;
+        }
+    }
+    return found == static_cast<uint32_t>(TextCategory::Other) ? fallback : static_cast<TextCategory>(found);
+}
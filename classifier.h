@@ -0,0 +1,63 @@
+#ifndef CLASSIFIER_H
+#define CLASSIFIER_H
+
+#include "text_store.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A literal substring that marks a line as belonging to a category. A
+// leading '^' anchors it to the start of the line.
+struct ClassifierPattern {
+    TextCategory category;
+    std::string text;
+};
+
+// The patterns used when no config is given: gcc/clang diagnostics, make
+// and CMake progress and failure lines, and linker errors.
+std::vector<ClassifierPattern> defaultClassifierPatterns();
+
+// "error", "warning", "note", "progress" or "other"
+bool parseTextCategory(std::string_view name, TextCategory& category);
+
+// Parses a pattern config: one "<category> <pattern>" per line, where
+// category is error, warning, note or progress and the pattern is the rest
+// of the line (wrap it in double quotes to keep leading or trailing spaces).
+// Blank lines and lines starting with '#' are ignored. Prints the offending
+// line and returns false on a syntax error.
+bool parseClassifierPatterns(std::string_view config, std::vector<ClassifierPattern>& patterns);
+bool loadClassifierPatterns(const std::string& path, std::vector<ClassifierPattern>& patterns);
+
+// Identifies a pattern set (the patterns, their categories and their
+// order), so a replay can check it classifies lines as the recording did
+uint64_t hashClassifierPatterns(const std::vector<ClassifierPattern>& patterns);
+
+// Tags log lines by the patterns they contain, in one pass over each line.
+// The patterns are compiled once into an Aho-Corasick automaton with every
+// transition filled in (a DFA), over byte classes so the table stays small
+// enough for L1. Classifying is then one table lookup per byte, and stops
+// early once an error pattern has matched.
+class LineClassifier {
+public:
+    explicit LineClassifier(const std::vector<ClassifierPattern>& patterns = defaultClassifierPatterns());
+
+    // The most severe category (error > warning > note > progress) of any
+    // pattern found in line, or fallback if none is.
+    TextCategory classify(std::string_view line, TextCategory fallback) const;
+
+    size_t stateCount() const { return output.size(); }
+
+private:
+    static const uint32_t OUTPUT_BITS = 3;
+
+    uint32_t classCount = 1;
+    uint16_t byteClass[256] = {};
+    // Transition table, one row of classCount edges per state. Each edge is
+    // (target row offset << OUTPUT_BITS) | target's category.
+    std::vector<uint32_t> next;
+    std::vector<TextCategory> output;
+    uint32_t start = 0;  // edge taken on the start-of-line marker
+};
+
+#endif
@@ -0,0 +1,299 @@
+#include "compressed_log.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// Compressed bytes read from the file at a time
+static const size_t COMPRESSED_READ_BYTES = 128u << 10;
+
+static const unsigned char gzipMagic[] = { 0x1F, 0x8B };
+static const unsigned char zstdMagic[] = { 0x28, 0xB5, 0x2F, 0xFD };
+
+static double steadySeconds() {
+    using Clock = std::chrono::steady_clock;
+    return std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+}
+
+static Compression compressionOf(const unsigned char* magic, ssize_t length) {
+    if (length >= 2 && std::memcmp(magic, gzipMagic, sizeof(gzipMagic)) == 0) return Compression::Gzip;
+    if (length >= 4 && std::memcmp(magic, zstdMagic, sizeof(zstdMagic)) == 0) return Compression::Zstd;
+    return Compression::None;
+}
+
+Compression detectCompression(const std::string& path) {
+    int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) return Compression::None;
+    unsigned char magic[4];
+    ssize_t length = pread(file, magic, sizeof(magic), 0);
+    ::close(file);
+    return compressionOf(magic, length);
+}
+
+const char* compressionName(Compression format) {
+    switch (format) {
+    case Compression::Gzip: return "gzip";
+    case Compression::Zstd: return "zstd";
+    case Compression::None: break;
+    }
+    return "none";
+}
+
+void printCompressedLogStats(std::ostream& out, const std::string& name, const CompressedLogStats& stats) {
+    const double megabyte = 1024.0 * 1024.0;
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(1);
+    out << name << ": " << stats.compressedBytes / megabyte << " MB compressed -> "
+        << stats.decompressedBytes / megabyte << " MB";
+    if (stats.decodeSeconds > 0.0) {
+        out << ", decoded at " << stats.decompressedBytes / megabyte / stats.decodeSeconds << " MB/s";
+    }
+    out << ", reader waited " << stats.readerStarved << " times";
+    if (!stats.finished) out << " (still decoding)";
+    out << std::endl;
+    out.flags(flags);
+}
+
+CompressedLog::CompressedLog(const std::string& path, bool wait)
+    : chunks(COMPRESSED_CHUNKS, std::vector<char>(COMPRESSED_CHUNK_BYTES)),
+      chunkBytes(COMPRESSED_CHUNKS, 0),
+      waitForData(wait) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Failed to open " << path << ": " << std::strerror(errno) << std::endl;
+        return;
+    }
+    unsigned char magic[4];
+    compression = compressionOf(magic, pread(fd, magic, sizeof(magic), 0));
+#ifndef HAVE_ZSTD
+    if (compression == Compression::Zstd) {
+        std::cerr << path << " is zstd-compressed, but this build has no zstd support (make ZSTD=1)" << std::endl;
+        compression = Compression::None;
+    }
+#endif
+    if (compression == Compression::None) {
+        if (fd >= 0) std::cerr << path << " is not a log this reader can decompress" << std::endl;
+        ::close(fd);
+        fd = -1;
+        return;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    readyFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    decoder = std::thread(&CompressedLog::decode, this);
+}
+
+CompressedLog::~CompressedLog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    chunkFreed.notify_all();
+    if (decoder.joinable()) decoder.join();
+    if (readyFd >= 0) ::close(readyFd);
+    if (fd >= 0) ::close(fd);
+}
+
+CompressedLogStats CompressedLog::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+std::vector<char>* CompressedLog::freeChunk() {
+    std::unique_lock<std::mutex> lock(mutex);
+    chunkFreed.wait(lock, [this]() { return closing || filledCount - takenCount < COMPRESSED_CHUNKS; });
+    if (closing) return nullptr;
+    return &chunks[filledCount % COMPRESSED_CHUNKS];
+}
+
+void CompressedLog::publish(size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        chunkBytes[filledCount % COMPRESSED_CHUNKS] = bytes;
+        filledCount++;
+        counters.decompressedBytes += bytes;
+    }
+    chunkFilled.notify_one();
+    uint64_t one = 1;
+    ssize_t written = write(readyFd, &one, sizeof(one));
+    (void)written;
+}
+
+uint64_t CompressedLog::decodedBytes(size_t unpublished) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters.decompressedBytes + unpublished;
+}
+
+void CompressedLog::decode() {
+    double start = steadySeconds();
+    if (compression == Compression::Gzip) {
+        decodeGzip();
+    } else {
+        decodeZstd();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        decoderDone = true;
+        counters.finished = true;
+        counters.elapsedSeconds = steadySeconds() - start;
+    }
+    chunkFilled.notify_one();
+    uint64_t one = 1;
+    ssize_t written = write(readyFd, &one, sizeof(one));
+    (void)written;
+}
+
+bool CompressedLog::decodeGzip() {
+    z_stream stream = {};
+    // 15 window bits, +32 to take a gzip or zlib header
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+        std::cerr << "Failed to start gzip decoder" << std::endl;
+        return false;
+    }
+    std::vector<unsigned char> input(COMPRESSED_READ_BYTES);
+    std::vector<char>* output = freeChunk();
+    size_t used = 0;
+    bool ok = output != nullptr;
+    while (output) {
+        double busyStart = steadySeconds();
+        if (stream.avail_in == 0) {
+            ssize_t length = read(fd, input.data(), input.size());
+            if (length < 0 && errno == EINTR) continue;
+            if (length <= 0) break;
+            stream.next_in = input.data();
+            stream.avail_in = static_cast<uInt>(length);
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.compressedBytes += static_cast<uint64_t>(length);
+        }
+        stream.next_out = reinterpret_cast<Bytef*>(output->data() + used);
+        stream.avail_out = static_cast<uInt>(output->size() - used);
+        int result = inflate(&stream, Z_NO_FLUSH);
+        used = output->size() - stream.avail_out;
+        if (result == Z_STREAM_END) {
+            // Another member may follow; if not, the next read ends the loop
+            inflateReset(&stream);
+        } else if (result != Z_OK && result != Z_BUF_ERROR) {
+            std::cerr << "Compressed log is corrupt (" << (stream.msg ? stream.msg : "inflate failed")
+                      << "); stopping at " << decodedBytes(used) << " bytes" << std::endl;
+            ok = false;
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.decodeSeconds += steadySeconds() - busyStart;
+        }
+        if (used == output->size()) {
+            publish(used);
+            output = freeChunk();
+            used = 0;
+        }
+    }
+    if (output && used > 0) publish(used);
+    inflateEnd(&stream);
+    return ok;
+}
+
+bool CompressedLog::decodeZstd() {
+#ifdef HAVE_ZSTD
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    if (!stream) {
+        std::cerr << "Failed to start zstd decoder" << std::endl;
+        return false;
+    }
+    std::vector<char> input(COMPRESSED_READ_BYTES);
+    std::vector<char>* output = freeChunk();
+    ZSTD_inBuffer in = { input.data(), 0, 0 };
+    size_t used = 0;
+    bool ok = output != nullptr;
+    while (output) {
+        double busyStart = steadySeconds();
+        if (in.pos == in.size) {
+            ssize_t length = read(fd, input.data(), input.size());
+            if (length < 0 && errno == EINTR) continue;
+            if (length <= 0) break;
+            in = { input.data(), static_cast<size_t>(length), 0 };
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.compressedBytes += static_cast<uint64_t>(length);
+        }
+        ZSTD_outBuffer out = { output->data() + used, output->size() - used, 0 };
+        size_t result = ZSTD_decompressStream(stream, &out, &in);
+        used += out.pos;
+        if (ZSTD_isError(result)) {
+            std::cerr << "Compressed log is corrupt (" << ZSTD_getErrorName(result) << "); stopping at "
+                      << decodedBytes(used) << " bytes" << std::endl;
+            ok = false;
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            counters.decodeSeconds += steadySeconds() - busyStart;
+        }
+        if (used == output->size()) {
+            publish(used);
+            output = freeChunk();
+            used = 0;
+        }
+    }
+    if (output && used > 0) publish(used);
+    ZSTD_freeDStream(stream);
+    return ok;
+#else
+    return false;
+#endif
+}
+
+bool CompressedLog::refill() {
+    if (fd < 0) return false;
+    uint64_t signalled;
+    ssize_t got = read(readyFd, &signalled, sizeof(signalled));
+    (void)got;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (filledCount == takenCount && !decoderDone) {
+        counters.readerStarved++;
+        if (!waitForData) return false;
+        chunkFilled.wait(lock, [this]() { return filledCount > takenCount || decoderDone; });
+    }
+    if (filledCount == takenCount) {
+        // Decoder finished and everything has been handed out: a last line
+        // without its '\n' is still a line
+        lock.unlock();
+        if (finishedPending) return false;
+        finishedPending = true;
+        pending.finish();
+        return true;
+    }
+
+    // The decoder leaves this chunk alone until it is given back
+    size_t slot = takenCount % COMPRESSED_CHUNKS;
+    size_t bytes = chunkBytes[slot];
+    lock.unlock();
+    pending.compact();
+    pending.append(chunks[slot].data(), bytes);
+
+    lock.lock();
+    takenCount++;
+    lock.unlock();
+    chunkFreed.notify_one();
+    return true;
+}
+
+void CompressedLog::poll() {
+    // nextLine() takes chunks as it runs out
+}
+
+bool CompressedLog::nextLine(std::string_view& line) {
+    while (!pending.next(line)) {
+        if (!refill()) return false;
+    }
+    return true;
+}
@@ -0,0 +1,106 @@
+#ifndef COMPRESSED_LOG_H
+#define COMPRESSED_LOG_H
+
+#include "log_reader.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Decompressed bytes handed from the decoder thread to the reader at a
+// time, and how many such chunks can be waiting. Together with the
+// decoder's own window this is all the memory a log takes, however big.
+#define COMPRESSED_CHUNK_BYTES (256u << 10)
+#define COMPRESSED_CHUNKS 8
+
+enum class Compression {
+    None,
+    Gzip,
+    Zstd
+};
+
+// Looks at the first bytes of a file, not its name
+Compression detectCompression(const std::string& path);
+const char* compressionName(Compression format);
+
+struct CompressedLogStats {
+    uint64_t compressedBytes = 0;
+    uint64_t decompressedBytes = 0;
+    double decodeSeconds = 0.0;  // reading and decompressing, not waiting
+    double elapsedSeconds = 0.0; // since the decoder started, until it finished
+    // Times the reader found no decompressed data while there was more to
+    // come: the decoder holding up playback. Zero when it keeps up.
+    uint64_t readerStarved = 0;
+    bool finished = false;
+};
+
+// One line: sizes, decode throughput and how often the reader waited
+void printCompressedLogStats(std::ostream& out, const std::string& name, const CompressedLogStats& stats);
+
+// Replays an archived gzip (or, built with HAVE_ZSTD, zstd) log without
+// decompressing it to disk or into memory. A decoder thread inflates the
+// file into a small ring of fixed-size chunks and waits whenever they are
+// all full, so it never runs more than COMPRESSED_CHUNKS chunks ahead of
+// the reader. Concatenated gzip members (as from parallel gzip) are read
+// back to back. Lines are filtered the same way as readAllLines.
+class CompressedLog : public LineSource {
+public:
+    // waitForData: nextLine() waits for the decoder rather than coming back
+    // empty while it catches up, so what is read never depends on timing.
+    // Leave it off behind an ingest thread, which is woken through waitFd().
+    CompressedLog(const std::string& path, bool waitForData);
+    ~CompressedLog() override;
+
+    CompressedLog(const CompressedLog&) = delete;
+    CompressedLog& operator=(const CompressedLog&) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+    Compression format() const { return compression; }
+
+    void poll() override;
+    bool nextLine(std::string_view& line) override;
+    // Readable whenever the decoder has filled a chunk
+    int waitFd() const override { return readyFd; }
+
+    // Safe from any thread
+    CompressedLogStats stats() const;
+
+private:
+    void decode();
+    bool decodeGzip();
+    bool decodeZstd();
+    // Decoder side: the chunk to fill next, after waiting for one to be
+    // free; null once the log is being closed
+    std::vector<char>* freeChunk();
+    void publish(size_t bytes);
+    // Decoder side: bytes decoded so far, counting the unpublished ones in
+    // the chunk being filled
+    uint64_t decodedBytes(size_t unpublished) const;
+    // Reader side: moves one decompressed chunk into pending
+    bool refill();
+
+    int fd = -1;
+    int readyFd = -1;
+    Compression compression = Compression::None;
+    std::thread decoder;
+
+    mutable std::mutex mutex;
+    std::condition_variable chunkFreed;
+    std::condition_variable chunkFilled;
+    std::vector<std::vector<char>> chunks;
+    std::vector<size_t> chunkBytes;
+    uint64_t filledCount = 0;  // chunks published by the decoder
+    uint64_t takenCount = 0;   // chunks taken by the reader
+    bool decoderDone = false;
+    bool closing = false;
+    CompressedLogStats counters;
+
+    bool waitForData;
+    bool finishedPending = false;
+    LineBuffer pending;
+};
+
+#endif
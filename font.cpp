@@ -0,0 +1,520 @@
+#include "font.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Empty pixels kept around each glyph so linear filtering doesn't pick up
+// its neighbours
+static const int glyphPadding = 1;
+
+// Bump when the cache file layout changes
+static const uint32_t glyphCacheVersion = 1;
+static const char glyphCacheMagic[8] = { 'G', 'L', 'Y', 'P', 'H', 'C', 'A', 'C' };
+
+struct GlyphCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t pixelHeight;
+    uint32_t pageSize;
+    uint32_t characterBytes;  // sizeof(Character), in case its layout changes
+    uint64_t fontHash;
+    uint32_t glyphCount;
+    uint32_t pageCount;
+};
+
+// Followed by glyphCount GlyphRecords, then pageCount pages of a
+// GlyphPageRecord and GLYPH_PAGE_SIZE^2 pixels each
+struct GlyphRecord {
+    uint32_t codepoint;
+    Character metrics;
+};
+
+struct GlyphPageRecord {
+    int32_t penX, penY, rowHeight, unused;
+};
+
+GlyphCache glyphCache;
+
+// Hashes the whole file, eight bytes at a time. A font is a few hundred KB,
+// so this is far cheaper than starting FreeType.
+static bool hashFile(const char* path, uint64_t& hash) {
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(mapping);
+    uint64_t h = 0xcbf29ce484222325ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        h = (h ^ word) * 0x9e3779b97f4a7c15ull;
+        h ^= h >> 32;
+    }
+    for (; i < size; i++) {
+        h = (h ^ bytes[i]) * 0x100000001b3ull;
+    }
+    munmap(mapping, size);
+    hash = h;
+    return true;
+}
+
+GlyphCache::GlyphCache() {
+    std::fill(std::begin(asciiAdvance), std::end(asciiAdvance), UNLOADED_ADVANCE);
+}
+
+GlyphCache::~GlyphCache() {
+    close();
+}
+
+bool GlyphCache::open(const char* fontPath, unsigned int pixelHeight, size_t budgetBytes) {
+    close();
+    if (!hashFile(fontPath, fontHash)) {
+        std::cerr << "ERROR::FREETYPE: Failed to load font" << std::endl;
+        return false;
+    }
+    fontFile = fontPath;
+    fontPixelHeight = pixelHeight;
+    maxPages = std::max<size_t>(1, budgetBytes / (GLYPH_PAGE_SIZE * GLYPH_PAGE_SIZE));
+    return true;
+}
+
+bool GlyphCache::openFace() {
+    if (faceFailed || fontFile.empty()) return false;
+    faceFailed = true;
+
+    // Initialize FreeType
+    if (FT_Init_FreeType(&library)) {
+        std::cerr << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+        library = nullptr;
+        return false;
+    }
+
+    // Load font
+    if (FT_New_Face(library, fontFile.c_str(), 0, &face)) {
+        std::cerr << "ERROR::FREETYPE: Failed to load font" << std::endl;
+        FT_Done_FreeType(library);
+        library = nullptr;
+        face = nullptr;
+        return false;
+    }
+    FT_Set_Pixel_Sizes(face, 0, fontPixelHeight);
+    faceFailed = false;
+    return true;
+}
+
+void GlyphCache::close() {
+    if (face) FT_Done_Face(face);
+    if (library) FT_Done_FreeType(library);
+    face = nullptr;
+    library = nullptr;
+    faceFailed = false;
+    fontFile.clear();
+
+    std::fill(std::begin(asciiLoaded), std::end(asciiLoaded), false);
+    std::fill(std::begin(asciiAdvance), std::end(asciiAdvance), UNLOADED_ADVANCE);
+    others.clear();
+    pages.clear();
+    openPage = -1;
+    counters = GlyphCacheStats();
+}
+
+std::string GlyphCache::cacheFilePath() const {
+    std::string dir;
+    const char* xdgCache = std::getenv("XDG_CACHE_HOME");
+    const char* home = std::getenv("HOME");
+    if (xdgCache && *xdgCache) {
+        dir = xdgCache;
+    } else if (home && *home) {
+        dir = std::string(home) + "/.cache";
+    } else {
+        dir = "/tmp";
+    }
+    char name[64];
+    std::snprintf(name, sizeof(name), "/glyphs-%016llx-%u.bin",
+                  static_cast<unsigned long long>(fontHash), fontPixelHeight);
+    return dir + "/gambit-build-game" + name;
+}
+
+bool GlyphCache::load(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;  // a cold start, nothing to complain about
+    struct stat info;
+    std::vector<unsigned char> data;
+    if (fstat(fd, &info) == 0) {
+        data.resize(static_cast<size_t>(info.st_size));
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t got = read(fd, data.data() + done, data.size() - done);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) break;
+            done += static_cast<size_t>(got);
+        }
+        data.resize(done);
+    }
+    ::close(fd);
+
+    GlyphCacheHeader header;
+    const size_t pageRecordBytes = sizeof(GlyphPageRecord) + GLYPH_PAGE_SIZE * GLYPH_PAGE_SIZE;
+    if (data.size() < sizeof(header)) return false;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, glyphCacheMagic, sizeof(glyphCacheMagic)) != 0 ||
+        header.version != glyphCacheVersion || header.fontHash != fontHash ||
+        header.pixelHeight != fontPixelHeight || header.pageSize != GLYPH_PAGE_SIZE ||
+        header.characterBytes != sizeof(Character) ||
+        data.size() != sizeof(header) + header.glyphCount * sizeof(GlyphRecord) +
+                       header.pageCount * pageRecordBytes) {
+        std::cerr << "Ignoring glyph cache " << path << ": written for another font or version" << std::endl;
+        return false;
+    }
+
+    // Start over from what the file holds, keeping the pages that fit the
+    // budget; glyphs on the rest are rasterized again when needed
+    std::fill(std::begin(asciiLoaded), std::end(asciiLoaded), false);
+    std::fill(std::begin(asciiAdvance), std::end(asciiAdvance), UNLOADED_ADVANCE);
+    others.clear();
+    size_t pagesKept = std::min<size_t>(header.pageCount, maxPages);
+    pages.assign(pagesKept, GlyphPage());
+
+    const unsigned char* cursor = data.data() + sizeof(header);
+    for (uint32_t i = 0; i < header.glyphCount; i++, cursor += sizeof(GlyphRecord)) {
+        GlyphRecord record;
+        std::memcpy(&record, cursor, sizeof(record));
+        Character& ch = record.codepoint < 128 ? ascii[record.codepoint] : others[record.codepoint];
+        ch = record.metrics;
+        if (ch.Page < 0 || ch.Page >= static_cast<int>(pagesKept)) ch.Page = -1;
+        if (ch.Page >= 0) pages[ch.Page].codepoints.push_back(record.codepoint);
+        if (record.codepoint < 128) {
+            asciiLoaded[record.codepoint] = true;
+            asciiAdvance[record.codepoint] = static_cast<uint16_t>(ch.Advance >> 6);
+        }
+    }
+    for (size_t i = 0; i < pagesKept; i++, cursor += pageRecordBytes) {
+        GlyphPageRecord record;
+        std::memcpy(&record, cursor, sizeof(record));
+        GlyphPage& page = pages[i];
+        page.pixels.assign(cursor + sizeof(record), cursor + pageRecordBytes);
+        page.penX = record.penX;
+        page.penY = record.penY;
+        page.rowHeight = record.rowHeight;
+        page.dirtyMinY = 0;
+        page.dirtyMaxY = GLYPH_PAGE_SIZE;
+    }
+    openPage = static_cast<int>(pagesKept) - 1;
+
+    counters = GlyphCacheStats();
+    counters.glyphsCached = header.glyphCount;
+    return true;
+}
+
+// Creates every missing directory above path
+static void makeParentDirectories(const std::string& path) {
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        mkdir(path.substr(0, slash).c_str(), 0755);
+    }
+}
+
+bool GlyphCache::save(const std::string& path) const {
+    if (fontFile.empty()) return false;
+    makeParentDirectories(path);
+
+    // Written beside the real file and renamed over it, so a reader never
+    // sees half a cache
+    std::string tempPath = path + "." + std::to_string(getpid()) + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to write glyph cache " << tempPath << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    GlyphCacheHeader header = {};
+    std::memcpy(header.magic, glyphCacheMagic, sizeof(glyphCacheMagic));
+    header.version = glyphCacheVersion;
+    header.pixelHeight = fontPixelHeight;
+    header.pageSize = GLYPH_PAGE_SIZE;
+    header.characterBytes = sizeof(Character);
+    header.fontHash = fontHash;
+    header.pageCount = static_cast<uint32_t>(pages.size());
+    for (bool loaded : asciiLoaded) header.glyphCount += loaded;
+    header.glyphCount += static_cast<uint32_t>(others.size());
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+
+    auto writeGlyph = [&](uint32_t codepoint, const Character& ch) {
+        GlyphRecord record = {};
+        record.codepoint = codepoint;
+        record.metrics = ch;
+        ok = ok && std::fwrite(&record, sizeof(record), 1, file) == 1;
+    };
+    for (uint32_t c = 0; c < 128; c++) {
+        if (asciiLoaded[c]) writeGlyph(c, ascii[c]);
+    }
+    for (const auto& entry : others) writeGlyph(entry.first, entry.second);
+
+    for (const GlyphPage& page : pages) {
+        GlyphPageRecord record = { page.penX, page.penY, page.rowHeight, 0 };
+        ok = ok && std::fwrite(&record, sizeof(record), 1, file) == 1;
+        ok = ok && std::fwrite(page.pixels.data(), page.pixels.size(), 1, file) == 1;
+    }
+
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to write glyph cache " << path << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+Character* GlyphCache::find(uint32_t codepoint) {
+    if (codepoint < 128) return asciiLoaded[codepoint] ? &ascii[codepoint] : nullptr;
+    auto it = others.find(codepoint);
+    return it == others.end() ? nullptr : &it->second;
+}
+
+Character& GlyphCache::loadMetrics(uint32_t codepoint) {
+    Character* ch;
+    if (codepoint < 128) {
+        ch = &ascii[codepoint];
+        asciiLoaded[codepoint] = true;
+    } else {
+        auto inserted = others.try_emplace(codepoint);
+        ch = &inserted.first->second;
+        if (!inserted.second) return *ch;
+    }
+
+    *ch = Character();
+    ch->Page = -1;
+    if (!face && !openFace()) return *ch;
+    if (FT_Load_Char(face, codepoint, FT_LOAD_DEFAULT)) {
+        std::cerr << "ERROR::FREETYPE: Failed to load Glyph " << codepoint << std::endl;
+        return *ch;
+    }
+    // Outline metrics are close enough for layout; the bitmap's exact size
+    // and bearing replace them when the glyph is rasterized
+    const FT_Glyph_Metrics& metrics = face->glyph->metrics;
+    ch->SizeX = static_cast<int>((metrics.width + 63) >> 6);
+    ch->SizeY = static_cast<int>((metrics.height + 63) >> 6);
+    ch->BearingX = static_cast<int>(metrics.horiBearingX >> 6);
+    ch->BearingY = static_cast<int>(metrics.horiBearingY >> 6);
+    ch->Advance = static_cast<unsigned int>(face->glyph->advance.x);
+    if (codepoint < 128) asciiAdvance[codepoint] = static_cast<uint16_t>(ch->Advance >> 6);
+    counters.glyphsLoaded++;
+    return *ch;
+}
+
+// Shelf-packs a width x height rectangle into page, if there is room
+static bool packInto(GlyphPage& page, int width, int height, int& x, int& y) {
+    if (page.penX + width + glyphPadding > GLYPH_PAGE_SIZE) {
+        page.penX = glyphPadding;
+        page.penY += page.rowHeight + glyphPadding;
+        page.rowHeight = 0;
+    }
+    if (page.penY + height + glyphPadding > GLYPH_PAGE_SIZE) return false;
+    x = page.penX;
+    y = page.penY;
+    page.penX += width + glyphPadding;
+    page.rowHeight = std::max(page.rowHeight, height);
+    return true;
+}
+
+static void resetPage(GlyphPage& page) {
+    page.pixels.assign(GLYPH_PAGE_SIZE * GLYPH_PAGE_SIZE, 0);
+    page.codepoints.clear();
+    page.penX = page.penY = glyphPadding;
+    page.rowHeight = 0;
+    page.dirtyMinY = 0;
+    page.dirtyMaxY = GLYPH_PAGE_SIZE;
+}
+
+void GlyphCache::evictPage(size_t index) {
+    GlyphPage& page = pages[index];
+    for (uint32_t codepoint : page.codepoints) {
+        Character* ch = find(codepoint);
+        if (ch) ch->Page = -1;
+    }
+    resetPage(page);
+    counters.pagesEvicted++;
+}
+
+int GlyphCache::placeGlyph(int width, int height, int& x, int& y) {
+    if (width + 2 * glyphPadding > GLYPH_PAGE_SIZE || height + 2 * glyphPadding > GLYPH_PAGE_SIZE) {
+        return -1;
+    }
+    if (openPage >= 0 && packInto(pages[openPage], width, height, x, y)) {
+        return openPage;
+    }
+
+    if (pages.size() < maxPages) {
+        pages.emplace_back();
+        resetPage(pages.back());
+        openPage = static_cast<int>(pages.size() - 1);
+    } else {
+        // Over budget: reuse the page drawn from longest ago, but never one
+        // already used this frame, whose glyphs are in the vertices queued
+        int victim = -1;
+        for (size_t i = 0; i < pages.size(); i++) {
+            if (pages[i].lastUsed >= frame) continue;
+            if (victim < 0 || pages[i].lastUsed < pages[victim].lastUsed) victim = static_cast<int>(i);
+        }
+        if (victim < 0) return -1;
+        evictPage(victim);
+        openPage = victim;
+    }
+    return packInto(pages[openPage], width, height, x, y) ? openPage : -1;
+}
+
+void GlyphCache::rasterize(uint32_t codepoint, Character& ch) {
+    if ((!face && !openFace()) || FT_Load_Char(face, codepoint, FT_LOAD_RENDER)) {
+        ch.SizeX = ch.SizeY = 0;  // don't try again
+        return;
+    }
+    const FT_Bitmap& bitmap = face->glyph->bitmap;
+    int width = static_cast<int>(bitmap.width);
+    int height = static_cast<int>(bitmap.rows);
+    ch.SizeX = width;
+    ch.SizeY = height;
+    ch.BearingX = face->glyph->bitmap_left;
+    ch.BearingY = face->glyph->bitmap_top;
+    if (width == 0 || height == 0) return;
+
+    int x = 0, y = 0;
+    int index = placeGlyph(width, height, x, y);
+    if (index < 0) {
+        counters.glyphsDropped++;
+        return;
+    }
+
+    GlyphPage& page = pages[index];
+    for (int row = 0; row < height; row++) {
+        std::memcpy(&page.pixels[(y + row) * GLYPH_PAGE_SIZE + x], bitmap.buffer + row * bitmap.pitch, width);
+    }
+    if (page.dirtyMaxY <= page.dirtyMinY) {
+        page.dirtyMinY = y;
+        page.dirtyMaxY = y + height;
+    } else {
+        page.dirtyMinY = std::min(page.dirtyMinY, y);
+        page.dirtyMaxY = std::max(page.dirtyMaxY, y + height);
+    }
+    page.codepoints.push_back(codepoint);
+
+    ch.Page = index;
+    ch.U0 = static_cast<float>(x) / GLYPH_PAGE_SIZE;
+    ch.V0 = static_cast<float>(y) / GLYPH_PAGE_SIZE;
+    ch.U1 = static_cast<float>(x + width) / GLYPH_PAGE_SIZE;
+    ch.V1 = static_cast<float>(y + height) / GLYPH_PAGE_SIZE;
+    counters.glyphsRasterized++;
+}
+
+static void appendGlyphQuad(std::vector<float>& vertices, const Character& ch, float penX, float y,
+                            float scale, float r, float g, float b) {
+    float xpos = penX + ch.BearingX * scale;
+    float ypos = y - (ch.SizeY - ch.BearingY) * scale;
+    float w = ch.SizeX * scale;
+    float h = ch.SizeY * scale;
+    float page = static_cast<float>(ch.Page);
+
+    float quad[6][TEXT_VERTEX_FLOATS] = {
+        { xpos,     ypos + h, ch.U0, ch.V0, page, r, g, b },
+        { xpos,     ypos,     ch.U0, ch.V1, page, r, g, b },
+        { xpos + w, ypos,     ch.U1, ch.V1, page, r, g, b },
+        { xpos,     ypos + h, ch.U0, ch.V0, page, r, g, b },
+        { xpos + w, ypos,     ch.U1, ch.V1, page, r, g, b },
+        { xpos + w, ypos + h, ch.U1, ch.V0, page, r, g, b }
+    };
+    vertices.insert(vertices.end(), &quad[0][0], &quad[0][0] + 6 * TEXT_VERTEX_FLOATS);
+}
+
+void appendTextQuads(std::vector<float>& vertices, std::string_view text,
+                     float x, float y, float scale, float r, float g, float b, float clipRight) {
+    float currentX = x;
+    size_t i = 0;
+    uint32_t codepoint;
+    while (currentX < clipRight && i < text.size() && nextCodepoint(text, i, codepoint)) {
+        const Character& ch = glyphCache.resident(codepoint);
+        // Whitespace, no glyph, or no room in the atlas: nothing to draw
+        if (ch.Page >= 0) appendGlyphQuad(vertices, ch, currentX, y, scale, r, g, b);
+        currentX += (ch.Advance >> 6) * scale;
+    }
+}
+
+void appendLayoutQuads(std::vector<float>& vertices, const LayoutGlyph* glyphs, size_t glyphCount,
+                       float x, float y, float scale, float r, float g, float b) {
+    for (size_t i = 0; i < glyphCount; i++) {
+        const Character& ch = glyphCache.resident(glyphs[i].codepoint);
+        if (ch.Page >= 0) appendGlyphQuad(vertices, ch, x + glyphs[i].x, y, scale, r, g, b);
+    }
+}
+
+size_t layoutText(std::string_view text, float x, float scale, float clipLeft, float clipRight,
+                  LayoutGlyph* glyphs, size_t maxGlyphs, float& width) {
+    const uint32_t ellipsis = 0x2026;
+
+    // Only a line that doesn't fit gives up room for the ellipsis
+    float limit = clipRight;
+    if (x + getTextWidth(text, scale) > clipRight) {
+        limit -= glyphCache.advance(ellipsis) * scale;
+    }
+
+    unsigned int pen = 0;
+    size_t count = 0;
+    bool truncated = false;
+    size_t i = 0;
+    uint32_t codepoint;
+    while (i < text.size() && nextCodepoint(text, i, codepoint)) {
+        unsigned int advance = glyphCache.advance(codepoint);
+        float right = x + (pen + advance) * scale;
+        if (right > limit) {
+            truncated = true;
+            break;
+        }
+        // Blank glyphs (spaces) only move the pen
+        if (right > clipLeft && count < maxGlyphs && glyphCache.metrics(codepoint).SizeX > 0) {
+            glyphs[count++] = { codepoint, pen * scale };
+        }
+        pen += advance;
+    }
+    if (truncated) {
+        if (count < maxGlyphs) glyphs[count++] = { ellipsis, pen * scale };
+        pen += glyphCache.advance(ellipsis);
+    }
+    width = pen * scale;
+    return count;
+}
+
+float getTextWidth(std::string_view text, float scale) {
+    // Advances are whole pixels, so sum them exactly and scale once
+    unsigned int advance = 0;
+    size_t i = 0;
+    uint32_t codepoint;
+    while (i < text.size()) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c < 0x80) {
+            advance += glyphCache.advance(c);
+            i++;
+            continue;
+        }
+        if (!nextCodepoint(text, i, codepoint)) break;
+        advance += glyphCache.advance(codepoint);
+    }
+    return advance * scale;
+}
+
+float getTextHeight(float scale) {
+    return 48.0f * scale;
+}
@@ -0,0 +1,226 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include "text_store.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#define FONT_PATH "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf"
+#define FONT_PIXEL_HEIGHT 48
+
+// Glyphs are packed into square pages of this many pixels a side
+#define GLYPH_PAGE_SIZE 512
+// Default limit on glyph page memory (one byte per pixel, same on the GPU)
+#define DEFAULT_GLYPH_BUDGET_BYTES (4u << 20)
+
+struct Character {
+    int SizeX, SizeY;
+    int BearingX, BearingY;
+    unsigned int Advance;
+    // Glyph rectangle inside its atlas page, in normalised texture coords.
+    // Page is -1 until the glyph has been rasterized, and again once its
+    // page has been evicted.
+    int Page;
+    float U0, V0, U1, V1;
+};
+
+// One page of glyph coverage, one byte per pixel, shelf-packed. Rows
+// [dirtyMinY, dirtyMaxY) changed since the renderer last uploaded them.
+struct GlyphPage {
+    std::vector<unsigned char> pixels;
+    std::vector<uint32_t> codepoints;  // glyphs placed here
+    uint64_t lastUsed = 0;             // frame this page was last drawn from
+    int penX = 0, penY = 0, rowHeight = 0;
+    int dirtyMinY = 0, dirtyMaxY = 0;
+};
+
+struct GlyphCacheStats {
+    uint64_t glyphsCached = 0;      // metrics restored from the cache file
+    uint64_t glyphsLoaded = 0;      // code points whose metrics were read
+    uint64_t glyphsRasterized = 0;  // including re-rasterized after eviction
+    uint64_t pagesEvicted = 0;
+    uint64_t glyphsDropped = 0;     // not drawn: every page was in use this frame
+};
+
+// Glyphs for any code point the font has, loaded when a string first needs
+// them. Layout only needs metrics, which are kept for every code point seen
+// (they are small). Drawing also needs the glyph's coverage in an atlas
+// page, which is rasterized on first use. Pages are added until the budget
+// is reached; after that the least recently drawn page is cleared and
+// reused, and its glyphs are rasterized again if they come back.
+//
+// What has been loaded can be saved to a file and restored on the next
+// start, metrics, pages and all, so a warm start is one read and the font is
+// only opened once something new turns up. The FreeType face then stays
+// open for the life of the cache. Nothing here needs a GL context; the
+// renderer uploads the pages.
+class GlyphCache {
+public:
+    GlyphCache();
+    ~GlyphCache();
+    GlyphCache(const GlyphCache&) = delete;
+    GlyphCache& operator=(const GlyphCache&) = delete;
+
+    // Checks the font can be read and hashes it; FreeType itself is only
+    // started when a glyph is missing
+    bool open(const char* fontPath, unsigned int pixelHeight, size_t budgetBytes = DEFAULT_GLYPH_BUDGET_BYTES);
+    void close();
+
+    // Where this font and size are cached: a file named after the font's
+    // hash and the pixel size, under $XDG_CACHE_HOME (or ~/.cache)
+    std::string cacheFilePath() const;
+
+    // Restores the glyphs saved by save(). Returns false, leaving the cache
+    // as it was, if the file is missing or was written for another font,
+    // size or page layout.
+    bool load(const std::string& path);
+    // Writes every glyph and page held, replacing the file atomically
+    bool save(const std::string& path) const;
+    // Whether anything was loaded or rasterized since open() or load()
+    bool changed() const { return counters.glyphsLoaded > 0 || counters.glyphsRasterized > 0; }
+
+    // Metrics only, for layout
+    const Character& metrics(uint32_t codepoint) { return entry(codepoint); }
+
+    // Just the advance in whole pixels, from a small table for ASCII
+    unsigned int advance(uint32_t codepoint) {
+        if (codepoint < 128 && asciiAdvance[codepoint] != UNLOADED_ADVANCE) return asciiAdvance[codepoint];
+        return entry(codepoint).Advance >> 6;
+    }
+
+    // Metrics and atlas placement, for drawing. Page is -1 if the glyph is
+    // blank or couldn't be placed.
+    const Character& resident(uint32_t codepoint) {
+        Character& ch = entry(codepoint);
+        if (ch.Page < 0 && ch.SizeX > 0) rasterize(codepoint, ch);
+        if (ch.Page >= 0) pages[ch.Page].lastUsed = frame;
+        return ch;
+    }
+
+    // Marks the end of a frame's drawing, for least-recently-used eviction
+    void endFrame() { frame++; }
+
+    size_t pageCount() const { return pages.size(); }
+    GlyphPage& page(size_t index) { return pages[index]; }
+    size_t pageBytes() const { return pages.size() * GLYPH_PAGE_SIZE * GLYPH_PAGE_SIZE; }
+    const GlyphCacheStats& stats() const { return counters; }
+
+private:
+    static const uint16_t UNLOADED_ADVANCE = 0xFFFF;
+
+    Character& entry(uint32_t codepoint) {
+        if (codepoint < 128 && asciiLoaded[codepoint]) return ascii[codepoint];
+        return loadMetrics(codepoint);
+    }
+    Character& loadMetrics(uint32_t codepoint);
+    void rasterize(uint32_t codepoint, Character& ch);
+    int placeGlyph(int width, int height, int& x, int& y);
+    void evictPage(size_t index);
+    Character* find(uint32_t codepoint);
+    bool openFace();
+
+    std::string fontFile;
+    unsigned int fontPixelHeight = 0;
+    uint64_t fontHash = 0;
+    FT_Library library = nullptr;
+    FT_Face face = nullptr;
+    bool faceFailed = false;
+    size_t maxPages = 0;
+    int openPage = -1;  // the page new glyphs are packed into
+    uint64_t frame = 1;
+
+    Character ascii[128] = {};
+    bool asciiLoaded[128] = {};
+    uint16_t asciiAdvance[128];
+    std::unordered_map<uint32_t, Character> others;
+    std::vector<GlyphPage> pages;
+    GlyphCacheStats counters;
+};
+
+// The font every text is laid out and drawn with
+extern GlyphCache glyphCache;
+
+// Decodes one UTF-8 sequence from text at position i and advances i past
+// it. Malformed bytes decode to U+FFFD one at a time. A sequence cut off by
+// the end of the text (as when a line is truncated) returns false.
+inline bool nextCodepoint(std::string_view text, size_t& i, uint32_t& codepoint) {
+    unsigned char lead = static_cast<unsigned char>(text[i]);
+    if (lead < 0x80) {
+        codepoint = lead;
+        i++;
+        return true;
+    }
+    int length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC2 ? 2 : 0;
+    if (length == 0 || lead > 0xF4) {
+        codepoint = 0xFFFD;
+        i++;
+        return true;
+    }
+    if (i + length > text.size()) {
+        // Stop at the cut unless one of the bytes present is already wrong
+        for (size_t j = i + 1; j < text.size(); j++) {
+            if ((static_cast<unsigned char>(text[j]) & 0xC0) != 0x80) {
+                codepoint = 0xFFFD;
+                i++;
+                return true;
+            }
+        }
+        i = text.size();
+        return false;
+    }
+    uint32_t value = lead & (0x7F >> length);
+    for (int k = 1; k < length; k++) {
+        unsigned char next = static_cast<unsigned char>(text[i + k]);
+        if ((next & 0xC0) != 0x80) {
+            codepoint = 0xFFFD;
+            i++;
+            return true;
+        }
+        value = (value << 6) | (next & 0x3F);
+    }
+    // Overlong forms, surrogates and anything past U+10FFFF
+    static const uint32_t minimum[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+    if (value < minimum[length] || (value >= 0xD800 && value <= 0xDFFF) || value > 0x10FFFF) {
+        codepoint = 0xFFFD;
+        i++;
+        return true;
+    }
+    codepoint = value;
+    i += length;
+    return true;
+}
+
+// Interleaved layout of one text vertex: x, y, u, v, page, r, g, b
+#define TEXT_VERTEX_FLOATS 8
+
+// Lays out UTF-8 text starting at (x, y) and appends two triangles per
+// glyph to vertices, in TEXT_VERTEX_FLOATS layout. Rasterizes any glyph
+// not yet in the atlas. Stops at the first glyph starting at or past
+// clipRight.
+void appendTextQuads(std::vector<float>& vertices, std::string_view text,
+                     float x, float y, float scale, float r, float g, float b,
+                     float clipRight = std::numeric_limits<float>::infinity());
+
+// Same, for glyphs already laid out by layoutText
+void appendLayoutQuads(std::vector<float>& vertices, const LayoutGlyph* glyphs, size_t glyphCount,
+                       float x, float y, float scale, float r, float g, float b);
+
+// Lays out text drawn from x for the span [clipLeft, clipRight]. A line too
+// long to fit is cut after the last glyph that leaves room for an ellipsis,
+// which ends it instead. Only glyphs with pixels that reach past clipLeft
+// are written to glyphs, at most maxGlyphs; returns how many, and sets
+// width to the extent of what is drawn (ellipsis included), from x.
+size_t layoutText(std::string_view text, float x, float scale, float clipLeft, float clipRight,
+                  LayoutGlyph* glyphs, size_t maxGlyphs, float& width);
+
+float getTextWidth(std::string_view text, float scale);
+float getTextHeight(float scale);
+
+#endif
@@ -0,0 +1,104 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <iomanip>
+#include <sys/resource.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+FixedTimestep::FixedTimestep(double step, double maxFrame)
+    : stepSeconds(step), maxFrameSeconds(maxFrame) {
+}
+
+unsigned int FixedTimestep::advance(double frameSeconds) {
+    accumulated += std::min(std::max(frameSeconds, 0.0), maxFrameSeconds);
+    unsigned int steps = static_cast<unsigned int>(accumulated / stepSeconds);
+    accumulated -= steps * stepSeconds;
+    return steps;
+}
+
+static double processCpuSeconds() {
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+FramePacer::FramePacer(double targetFps, double idleFps, bool vsync, double displayHz)
+    : period(targetFps > 0.0 ? 1.0 / targetFps : 0.0),
+      idlePeriod(idleFps > 0.0 ? 1.0 / idleFps : 0.0),
+      refreshHz(displayHz),
+      trustVsync(vsync && displayHz > 0.0 && (targetFps <= 0.0 || targetFps >= displayHz)) {
+#ifdef __linux__
+    // The default 50 us of slack would make every wakeup that much late
+    prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+#endif
+    startSeconds = windowStart = deadline = now();
+    startCpuSeconds = processCpuSeconds();
+}
+
+double FramePacer::now() const {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+double FramePacer::frameDone(bool idle) {
+    double current = now();
+    frames++;
+    if (idle) idleFrames++;
+
+    // Half again the refresh rate can't be the display waiting on us
+    windowFrames++;
+    if (current - windowStart >= 1.0) {
+        if (trustVsync && windowFrames > 1.5 * refreshHz * (current - windowStart)) {
+            trustVsync = false;
+        }
+        windowStart = current;
+        windowFrames = 0;
+    }
+
+    double interval = idle ? idlePeriod : trustVsync ? 0.0 : period;
+    if (interval <= 0.0) {
+        deadline = current;
+        return 0.0;
+    }
+    // Deadlines follow on from each other so rounding doesn't drift the
+    // rate, but a frame that ran long starts a new schedule rather than
+    // being made up for by rushing the next ones, and none is ever more
+    // than an interval away (an idle wait cut short by a key press)
+    deadline = std::min(std::max(deadline + interval, current), current + interval);
+    return deadline - current;
+}
+
+void FramePacer::sleepUntilDeadline() {
+    timespec wake;
+    wake.tv_sec = static_cast<time_t>(deadline);
+    wake.tv_nsec = static_cast<long>((deadline - wake.tv_sec) * 1e9);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) == EINTR) {
+    }
+    double late = now() - deadline;
+    sleeps++;
+    lateTotal += late;
+    lateMax = std::max(lateMax, late);
+}
+
+void FramePacer::printSummary(std::ostream& out) const {
+    double elapsed = now() - startSeconds;
+    if (elapsed <= 0.0) return;
+    double cpu = processCpuSeconds() - startCpuSeconds;
+
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(1);
+    out << "Frames: " << frames << " in " << elapsed << " s (" << frames / elapsed << " fps), " << idleFrames
+        << " idle; paced by " << (trustVsync ? "vsync" : period > 0.0 ? "sleeping" : "nothing");
+    if (sleeps > 0) {
+        out << ", wakeups late by " << lateTotal / sleeps * 1e6 << " us on average, " << lateMax * 1e6 << " us at most";
+    }
+    out << std::endl;
+    out << "CPU: " << cpu << " s, " << 100.0 * cpu / elapsed << "% of one core" << std::endl;
+    out.flags(flags);
+}
@@ -0,0 +1,84 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <cstdint>
+#include <ostream>
+
+// The game steps its simulation at this rate whatever it draws at, like
+// game_headless's default --dt, so a session plays out the same on any
+// display
+#define FIXED_TIMESTEP_SECONDS (1.0 / 60.0)
+// Longest stretch of real time one frame may catch up on; anything past it
+// (a stall, a debugger) is dropped rather than simulated in a burst
+#define MAX_FRAME_SECONDS 1.0
+
+#define DEFAULT_TARGET_FPS 60.0
+#define DEFAULT_IDLE_FPS 4.0
+
+// Turns frames of varying length into whole simulation steps. The time
+// left over is carried to the next frame; alpha() says how far into the
+// next step it reaches, for drawing between the last two steps.
+class FixedTimestep {
+public:
+    explicit FixedTimestep(double stepSeconds = FIXED_TIMESTEP_SECONDS, double maxFrameSeconds = MAX_FRAME_SECONDS);
+
+    // Adds a frame's real time and returns how many steps are now due
+    unsigned int advance(double frameSeconds);
+
+    float step() const { return static_cast<float>(stepSeconds); }
+    float alpha() const { return static_cast<float>(accumulated / stepSeconds); }
+
+private:
+    double stepSeconds;
+    double maxFrameSeconds;
+    double accumulated = 0.0;
+};
+
+// Keeps the render loop to a target frame rate by sleeping to an absolute
+// deadline each frame (clock_nanosleep on CLOCK_MONOTONIC, with the timer
+// slack cut so wakeups are on time), and to a few frames a second when
+// idle. When vsync is on and the display is no faster than the target the
+// swap already waits for the display, so no sleeping is added, unless
+// frames turn out to run well past the refresh rate, which means the
+// driver is ignoring the swap interval.
+class FramePacer {
+public:
+    // targetFps 0 means no cap. refreshHz is the display's, 0 if unknown.
+    FramePacer(double targetFps, double idleFps, bool vsync, double refreshHz);
+
+    // Call once a frame has been presented. Returns how long to wait before
+    // starting the next one (0 if it is already due); an idle frame waits
+    // the idle interval.
+    double frameDone(bool idle);
+    // Sleeps until the deadline frameDone() set
+    void sleepUntilDeadline();
+
+    // Whether the swap is what paces frames
+    bool vsyncPacing() const { return trustVsync; }
+
+    // Frames, how late the sleeps woke, and the process's CPU use (every
+    // thread, as a share of one core) since the pacer was made
+    void printSummary(std::ostream& out) const;
+
+private:
+    double now() const;
+
+    double period;
+    double idlePeriod;
+    double refreshHz;
+    bool trustVsync;
+    double deadline = 0.0;
+
+    double startSeconds;
+    double startCpuSeconds;
+    uint64_t frames = 0;
+    uint64_t idleFrames = 0;
+    // Frames over the current second, to catch a swap interval that is ignored
+    double windowStart;
+    uint64_t windowFrames = 0;
+    uint64_t sleeps = 0;
+    double lateTotal = 0.0;
+    double lateMax = 0.0;
+};
+
+#endif
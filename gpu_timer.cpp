@@ -0,0 +1,82 @@
+#include "gpu_timer.h"
+
+#include <GL/glew.h>
+#include <iostream>
+
+bool GpuTimer::init(FrameProfiler& frameProfiler) {
+    if (!frameProfiler.enabled()) return false;
+
+    // Elapsed-time queries are core in 3.3, but a driver may still report
+    // zero counter bits, meaning the results would be meaningless
+    GLint bits = 0;
+    glGetQueryiv(GL_TIME_ELAPSED, GL_QUERY_COUNTER_BITS, &bits);
+    if (bits == 0) {
+        std::cerr << "GPU timer queries not supported by this driver; GPU passes won't be timed" << std::endl;
+        return false;
+    }
+
+    for (auto& query : queries) {
+        glGenQueries(1, &query.id);
+    }
+    profiler = &frameProfiler;
+    return true;
+}
+
+void GpuTimer::destroy() {
+    if (!profiler) return;
+    for (auto& query : queries) {
+        glDeleteQueries(1, &query.id);
+        query = Query();
+    }
+    profiler = nullptr;
+}
+
+void GpuTimer::begin(const char* name) {
+    if (!profiler || running) return;
+
+    Query& query = queries[next];
+    if (query.pending && !readResult(query)) {
+        // Still in flight a whole ring later; reuse it and lose that sample
+        dropped++;
+        query.pending = false;
+    }
+
+    query.name = name;
+    query.issuedUs = profiler->nowUs();
+    glBeginQuery(GL_TIME_ELAPSED, query.id);
+    running = true;
+}
+
+void GpuTimer::end() {
+    if (!profiler || !running) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    queries[next].pending = true;
+    next = (next + 1) % GPU_TIMER_QUERIES;
+    running = false;
+}
+
+void GpuTimer::collect() {
+    if (!profiler) return;
+    // Oldest first, stopping at the first one not done yet: the GPU finishes
+    // them in order
+    for (size_t i = 0; i < GPU_TIMER_QUERIES; i++) {
+        Query& query = queries[(next + i) % GPU_TIMER_QUERIES];
+        if (query.pending && !readResult(query)) break;
+    }
+}
+
+// Never blocks: returns false if the result isn't available yet
+bool GpuTimer::readResult(Query& query) {
+    GLint available = 0;
+    glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) return false;
+
+    GLuint64 elapsedNs = 0;
+    glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &elapsedNs);
+    query.pending = false;
+
+    // The GPU's own start time isn't known without timestamp queries; the
+    // pass is drawn on the GPU row starting where the CPU issued it
+    profiler->recordPhase(query.name, query.issuedUs, elapsedNs / 1000.0, FrameProfiler::GPU_TRACK);
+    return true;
+}
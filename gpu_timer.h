@@ -0,0 +1,47 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include "profiler.h"
+#include <cstdint>
+
+// Enough for two passes a frame with several frames still in flight
+#define GPU_TIMER_QUERIES 16
+
+// GL_TIME_ELAPSED queries around render passes. Results are collected a few
+// frames later, once GL_QUERY_RESULT_AVAILABLE says they are ready, so timing
+// never makes the CPU wait on the GPU. Only one pass can be timed at a time
+// (GL doesn't nest elapsed-time queries).
+class GpuTimer {
+public:
+    // Returns false, and leaves every call a no-op, when the driver has no
+    // timer bits (some software rasterizers) or profiling is off.
+    bool init(FrameProfiler& profiler);
+    void destroy();
+
+    void begin(const char* name);
+    void end();
+
+    // Hands every finished query to the profiler on its GPU track
+    void collect();
+
+    // Queries overwritten before their result came back
+    uint64_t droppedSamples() const { return dropped; }
+
+private:
+    struct Query {
+        unsigned int id = 0;
+        const char* name = nullptr;
+        double issuedUs = 0.0;
+        bool pending = false;
+    };
+
+    bool readResult(Query& query);
+
+    FrameProfiler* profiler = nullptr;
+    Query queries[GPU_TIMER_QUERIES];
+    size_t next = 0;
+    bool running = false;
+    uint64_t dropped = 0;
+};
+
+#endif
@@ -0,0 +1,281 @@
+#include "alloc_counter.h"
+#include "compressed_log.h"
+#include "font.h"
+#include "ingest.h"
+#include "log_reader.h"
+#include "profiler.h"
+#include "simulation.h"
+#include "trace.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Runs the game logic with no window or GL context, as fast as the CPU
+// allows, on a fixed timestep. Used to load-test the simulation against
+// large logs on machines without a display, and to replay sessions
+// recorded by the game frame for frame.
+int main(int argc, char* argv[]) {
+    double simSeconds = 60.0;
+    double timestep = 1.0 / 60.0;
+    std::string profilePath;
+    std::string classifyPath;
+    std::string recordPath;
+    std::string replayPath;
+    bool threaded = false;
+    bool live = false;
+    DedupConfig dedup;
+    // Files in the order given, plain or as --lane specs, and their lanes
+    std::vector<std::string> files;
+    std::vector<SourceLane> laneConfigs;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--seconds" && i + 1 < argc) {
+            simSeconds = std::atof(argv[++i]);
+        } else if (arg == "--dt" && i + 1 < argc) {
+            timestep = std::atof(argv[++i]);
+        } else if (arg == "--threaded") {
+            threaded = true;
+        } else if (arg == "--live") {
+            live = true;
+        } else if (arg == "--no-dedup") {
+            dedup.enabled = false;
+        } else if (arg == "--dedup-normalize") {
+            dedup.normalize = true;
+        } else if (arg == "--profile" && i + 1 < argc) {
+            profilePath = argv[++i];
+        } else if (arg == "--classify" && i + 1 < argc) {
+            classifyPath = argv[++i];
+        } else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (arg == "--lane" && i + 1 < argc) {
+            std::string path;
+            SourceLane lane = defaultSourceLane(files.size());
+            if (!parseLaneSpec(argv[++i], path, lane)) {
+                return -1;
+            }
+            files.push_back(path);
+            laneConfigs.push_back(lane);
+        } else {
+            files.push_back(arg);
+            laneConfigs.push_back(defaultSourceLane(laneConfigs.size()));
+        }
+    }
+    bool replaying = !replayPath.empty();
+    bool sourcesGiven = replaying ? files.empty() : !files.empty() && files.size() <= MAX_SOURCE_LANES;
+    if (!sourcesGiven || simSeconds <= 0.0 || timestep <= 0.0) {
+        std::cerr << "Usage: " << argv[0] << " [--seconds N] [--dt STEP] [--profile TRACE.json] [--classify PATTERNS] [--threaded] [--live] [--no-dedup] [--dedup-normalize] [--record SESSION] <red_text_file> [<green_text_file> ...] [--lane LANE ...]" << std::endl;
+        std::cerr << "       " << argv[0] << " [--profile TRACE.json] [--classify PATTERNS] [--no-dedup] [--dedup-normalize] --replay SESSION" << std::endl;
+        std::cerr << "Example: " << argv[0] << " --seconds 600 test_text.cpp test_text2.cpp" << std::endl;
+        std::cerr << "  --threaded  read through the ingest thread like the game (results vary run to run)" << std::endl;
+        std::cerr << "  --live      schedule spawns as for a live build, with the whole file arriving at once" << std::endl;
+        std::cerr << "  --no-dedup  spawn every repeat of a falling line instead of counting it on that text" << std::endl;
+        std::cerr << "  --dedup-normalize  count lines differing only in directories and numbers as repeats" << std::endl;
+        std::cerr << "  --lane      a file with its own look: PATH[,category=NAME][,color=RRGGBB][,weight=N]" << std::endl;
+        std::cerr << "  --record    write each step's input and the lines it took to SESSION" << std::endl;
+        std::cerr << "  --replay    run a session recorded by the game (or --record) as fast as possible;" << std::endl;
+        std::cerr << "              pass the same --classify and dedup options it was recorded with" << std::endl;
+        return -1;
+    }
+
+    // Collision needs real glyph advances, so the font is still loaded
+    if (!glyphCache.open(FONT_PATH, FONT_PIXEL_HEIGHT)) {
+        return -1;
+    }
+    // Metrics left by the game, if any; only it writes the cache
+    glyphCache.load(glyphCache.cacheFilePath());
+
+    // Read straight from the mappings unless asked to go through the ingest
+    // thread, which makes what is available at each step depend on timing
+    IngestThread ingest;
+    TraceReader replay;
+    std::vector<std::unique_ptr<LineSource>> fileSources;
+    std::vector<std::pair<std::string, const CompressedLog*>> compressedLogs;
+    if (replaying) {
+        if (!replay.open(replayPath)) {
+            return -1;
+        }
+        laneConfigs = replay.sourceLanes();
+        live = replay.settings().realTime;
+    } else {
+        for (size_t i = 0; i < files.size(); i++) {
+            bool opened;
+            if (detectCompression(files[i]) != Compression::None) {
+                // Without the ingest thread, wait for the decoder so runs repeat
+                auto compressed = std::make_unique<CompressedLog>(files[i], !threaded);
+                opened = compressed->isOpen();
+                compressedLogs.emplace_back(files[i], compressed.get());
+                fileSources.push_back(std::move(compressed));
+            } else {
+                auto mapped = std::make_unique<MappedLog>(files[i]);
+                opened = mapped->isOpen();
+                fileSources.push_back(std::move(mapped));
+            }
+            if (!opened) {
+                std::cerr << "Failed to open input file " << files[i] << std::endl;
+                return -1;
+            }
+            laneConfigs[i].source = fileSources.back().get();
+            laneConfigs[i].name = files[i];
+        }
+        if (threaded) {
+            for (size_t i = 0; i < files.size(); i++) {
+                laneConfigs[i].source = &ingest.addLane(std::move(fileSources[i]));
+            }
+            ingest.start();
+        }
+    }
+
+    std::vector<ClassifierPattern> patterns;
+    if (classifyPath.empty()) {
+        patterns = defaultClassifierPatterns();
+    } else if (!loadClassifierPatterns(classifyPath, patterns)) {
+        return -1;
+    }
+    // A replay merges repeats as its recording did
+    if (replaying && !replay.applySettings(hashClassifierPatterns(patterns), dedup)) {
+        return -1;
+    }
+
+    TraceWriter trace;
+    std::vector<std::unique_ptr<RecordingSource>> recorders;
+    if (!recordPath.empty()) {
+        TraceSettings traceSettings;
+        traceSettings.realTime = live;
+        traceSettings.dedup = dedup;
+        traceSettings.classifierHash = hashClassifierPatterns(patterns);
+        if (!trace.open(recordPath, traceSettings, laneConfigs)) {
+            return -1;
+        }
+        for (size_t i = 0; i < laneConfigs.size(); i++) {
+            recorders.push_back(std::make_unique<RecordingSource>(*laneConfigs[i].source, trace, i));
+            laneConfigs[i].source = recorders.back().get();
+        }
+    }
+
+    Simulation simulation(laneConfigs);
+    if (live) {
+        SpawnConfig spawnConfig;
+        spawnConfig.realTime = true;
+        simulation.setSpawnConfig(spawnConfig);
+    }
+    if (!classifyPath.empty()) {
+        simulation.setClassifier(LineClassifier(patterns));
+    }
+    const WorldState& world = simulation.state();
+
+    // Each step is traced as a frame with the simulation's phases inside it
+    FrameProfiler profiler;
+    if (!profilePath.empty() && !profiler.open(profilePath)) {
+        return -1;
+    }
+    simulation.setProfiler(&profiler);
+    simulation.setDedupConfig(dedup);
+
+    // Sweep the player back and forth so collisions actually happen
+    const double sweepPeriod = 4.0;
+    uint64_t steps = replaying ? replay.frameTotal() : static_cast<uint64_t>(simSeconds / timestep);
+    double simulated = 0.0;
+
+    // Allocations are only counted once the store and buffers have grown
+    // to their working size
+    const uint64_t warmupSteps = steps / 10;
+    uint64_t allocationsAtWarmup = 0;
+
+    // Glyphs on screen summed over steps: what a renderer would have drawn
+    uint64_t glyphsDrawn = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < steps; i++) {
+        if (i == warmupSteps) allocationsAtWarmup = heapAllocationCount();
+
+        SimInput input;
+        if (replaying) {
+            replay.nextFrame(input);
+        } else {
+            double simTime = i * timestep;
+            bool goLeft = static_cast<uint64_t>(simTime / (sweepPeriod / 2.0)) % 2 == 0;
+            input.deltaTime = static_cast<float>(timestep);
+            input.moveLeft = goLeft;
+            input.moveRight = !goLeft;
+        }
+        simulated += input.deltaTime;
+        trace.frame(input);
+        profiler.beginFrame();
+        simulation.step(input);
+        profiler.endFrame();
+        glyphsDrawn += world.fallingTexts.layoutGlyphCount();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ingest.stop();
+
+    if (replaying) {
+        std::cout << "Replayed " << simulated << " s in " << steps << " frames, " << replay.lines()
+                  << " lines" << std::endl;
+    } else {
+        std::cout << "Simulated " << simulated << " s in " << steps << " steps of " << timestep << " s" << std::endl;
+    }
+    std::cout << "Wall time: " << elapsed << " s (" << steps / elapsed << " steps/s, "
+              << simulated / elapsed << "x real time)" << std::endl;
+    std::cout << "Spawned texts: " << world.spawnedTexts
+              << ", on screen at end: " << world.fallingTexts.size() << std::endl;
+    std::cout << "  errors " << world.spawnedByCategory[static_cast<size_t>(TextCategory::Error)]
+              << ", warnings " << world.spawnedByCategory[static_cast<size_t>(TextCategory::Warning)]
+              << ", notes " << world.spawnedByCategory[static_cast<size_t>(TextCategory::Note)]
+              << ", progress " << world.spawnedByCategory[static_cast<size_t>(TextCategory::Progress)]
+              << ", other " << world.spawnedByCategory[static_cast<size_t>(TextCategory::Other)] << std::endl;
+    std::cout << "  by lane:";
+    for (size_t i = 0; i < laneConfigs.size(); i++) {
+        std::cout << (i == 0 ? " " : ", ") << laneConfigs[i].name << " " << world.spawnedByLane[i];
+    }
+    std::cout << std::endl;
+    std::cout << "Final health: " << world.playerHealth
+              << (world.isGameOver ? " (game over)" : "") << std::endl;
+    // Per line taken, so runs that got different distances into a log
+    // compare
+    const DedupStats& merged = simulation.dedupStats();
+    uint64_t linesTaken = world.spawnedTexts + merged.linesMerged;
+    if (dedup.enabled) {
+        std::cout << "Repeats merged: " << merged.linesMerged << " of " << linesTaken << " lines ("
+                  << (linesTaken ? 100.0 * merged.linesMerged / linesTaken : 0.0) << "% fewer texts), "
+                  << merged.bytesMerged << " bytes of text not spawned" << std::endl;
+    }
+    std::cout << "Glyphs drawn: " << glyphsDrawn << " (" << (steps ? glyphsDrawn / steps : 0) << " per step, "
+              << (linesTaken ? glyphsDrawn / linesTaken : 0) << " per line taken)" << std::endl;
+    if (live) {
+        const SpawnStats& spawn = simulation.spawnStats();
+        std::cout << "Scheduler: " << spawn.linesIn << " lines in, " << spawn.linesSpawned << " spawned, "
+                  << spawn.summariesSpawned << " skip summaries, dropped " << spawn.droppedOverflow
+                  << " (backlog full) + " << spawn.droppedStale << " (stale), of which errors "
+                  << spawn.errorsDropped << std::endl;
+    }
+    if (world.heldSpawns > 0) {
+        std::cout << "Lines held back (store full): " << world.heldSpawns << " (" << world.fallingTexts.droppedSpawns()
+                  << " spawns refused)" << std::endl;
+    }
+    if (threaded) {
+        for (size_t i = 0; i < ingest.laneCount(); i++) {
+            IngestStats stats = ingest.lane(i).stats();
+            std::cout << laneConfigs[i].name << " ingest: " << stats.linesRead << " lines read, queue "
+                      << stats.queueDepth << "/" << stats.queueCapacity << ", dropped " << stats.linesDropped
+                      << ", truncated " << stats.linesTruncated << std::endl;
+        }
+    }
+    for (const auto& [path, log] : compressedLogs) {
+        printCompressedLogStats(std::cout, path, log->stats());
+    }
+    if (allocationCountingEnabled()) {
+        std::cout << "Heap allocations after warm-up: " << heapAllocationCount() - allocationsAtWarmup
+                  << " over " << steps - warmupSteps << " steps" << std::endl;
+    }
+    if (trace.isOpen()) {
+        std::cout << "Recorded " << trace.frames() << " frames, " << trace.lines() << " lines to "
+                  << recordPath << std::endl;
+    }
+    profiler.printSummary(std::cout);
+    return 0;
+}
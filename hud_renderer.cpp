@@ -0,0 +1,86 @@
+#include "hud_renderer.h"
+
+#include <GL/glew.h>
+
+// Per-instance floats: rect (x, y, width, height), colour (r, g, b), role
+#define HUD_INSTANCE_FLOATS 8
+
+void HudRenderer::init(unsigned int hudShader, const std::vector<HudQuad>& quads) {
+    shader = hudShader;
+    playerOffsetLoc = glGetUniformLocation(shader, "playerOffset");
+    playerColorLoc = glGetUniformLocation(shader, "playerColor");
+    healthLoc = glGetUniformLocation(shader, "health");
+    healthColorLoc = glGetUniformLocation(shader, "healthColor");
+
+    // Unit square, stretched onto each rectangle in the vertex shader
+    const float quadVertices[] = {
+        0.0f, 0.0f,  // bottom left
+        1.0f, 0.0f,  // bottom right
+        1.0f, 1.0f,  // top right
+        0.0f, 1.0f   // top left
+    };
+    const unsigned int indices[] = {
+        0, 1, 2,
+        2, 3, 0
+    };
+
+    std::vector<float> instances;
+    instances.reserve(quads.size() * HUD_INSTANCE_FLOATS);
+    for (const auto& quad : quads) {
+        instances.insert(instances.end(), { quad.x, quad.y, quad.width, quad.height,
+                                            quad.color.r, quad.color.g, quad.color.b,
+                                            static_cast<float>(quad.role) });
+    }
+    instanceCount = static_cast<int>(quads.size());
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &quadVBO);
+    glGenBuffers(1, &instanceVBO);
+    glGenBuffers(1, &EBO);
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(float), instances.data(), GL_STATIC_DRAW);
+    const GLsizei stride = HUD_INSTANCE_FLOATS * sizeof(float);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(float)));
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (void*)(7 * sizeof(float)));
+    for (unsigned int attribute = 1; attribute <= 3; attribute++) {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void HudRenderer::destroy() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &quadVBO);
+    glDeleteBuffers(1, &instanceVBO);
+    glDeleteBuffers(1, &EBO);
+    VAO = quadVBO = instanceVBO = EBO = 0;
+}
+
+void HudRenderer::draw(float playerX, float playerY, const Color& playerColor,
+                       float healthFraction, const Color& healthColor) {
+    glUseProgram(shader);
+    glUniform2f(playerOffsetLoc, playerX, playerY);
+    glUniform3f(playerColorLoc, playerColor.r, playerColor.g, playerColor.b);
+    glUniform1f(healthLoc, healthFraction);
+    glUniform3f(healthColorLoc, healthColor.r, healthColor.g, healthColor.b);
+
+    glBindVertexArray(VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, instanceCount);
+    glBindVertexArray(0);
+    counters.drawCalls++;
+    counters.stateChanges += 7;  // program, four uniforms, VAO bind and unbind
+}
@@ -0,0 +1,53 @@
+#ifndef HUD_RENDERER_H
+#define HUD_RENDERER_H
+
+#include "render_stats.h"
+#include "text_store.h"
+#include <vector>
+
+// What, besides its own rectangle and colour, moves a HUD quad each frame
+enum class HudRole {
+    Static = 0,
+    Player = 1,     // shifted by the player position, drawn in the player colour
+    HealthBar = 2   // width scaled by health, drawn in the health colour
+};
+
+// A rectangle in normalized device coordinates, given by its bottom-left
+// corner and size
+struct HudQuad {
+    float x, y, width, height;
+    Color color;
+    HudRole role;
+};
+
+// Draws every HUD rectangle with one instanced call. A single unit quad is
+// shared by all of them; each rectangle is an instance with its own
+// position, size, colour and role, uploaded once at init. What changes per
+// frame (player position, health and their colours) is passed as uniforms,
+// so nothing is re-uploaded. Quads are drawn in the order given, later ones
+// on top.
+class HudRenderer {
+public:
+    void init(unsigned int shader, const std::vector<HudQuad>& quads);
+    void destroy();
+
+    void draw(float playerX, float playerY, const Color& playerColor,
+              float healthFraction, const Color& healthColor);
+
+    const RenderStats& stats() const { return counters; }
+
+private:
+    unsigned int shader = 0;
+    unsigned int VAO = 0;
+    unsigned int quadVBO = 0;
+    unsigned int instanceVBO = 0;
+    unsigned int EBO = 0;
+    int instanceCount = 0;
+    int playerOffsetLoc = -1;
+    int playerColorLoc = -1;
+    int healthLoc = -1;
+    int healthColorLoc = -1;
+    RenderStats counters;
+};
+
+#endif
@@ -0,0 +1,378 @@
+#include "ingest.h"
+#include "text_store.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Upper bound on lines moved from one lane per pass, so a lane with a huge
+// backlog can't starve the others
+static const size_t pumpBatchLines = 256;
+
+static size_t roundUpPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+LineRing::LineRing(size_t capacity)
+    : mask(roundUpPowerOfTwo(capacity < 2 ? 2 : capacity) - 1),
+      slotBytes(MAX_TEXT_BYTES),
+      bytes((mask + 1) * slotBytes),
+      lengths(mask + 1) {
+}
+
+bool LineRing::full() {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - cachedTail <= mask) return false;
+    cachedTail = tail.load(std::memory_order_acquire);
+    return h - cachedTail > mask;
+}
+
+bool LineRing::push(std::string_view line) {
+    if (full()) return false;
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t slot = h & mask;
+    size_t length = line.size() < slotBytes ? line.size() : slotBytes;
+    line.copy(bytes.data() + slot * slotBytes, length);
+    lengths[slot] = static_cast<uint32_t>(length);
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+bool LineRing::front(std::string_view& line) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t == cachedHead) {
+        cachedHead = head.load(std::memory_order_acquire);
+        if (t == cachedHead) return false;
+    }
+    size_t slot = t & mask;
+    line = std::string_view(bytes.data() + slot * slotBytes, lengths[slot]);
+    return true;
+}
+
+void LineRing::pop() {
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+size_t LineRing::size() const {
+    size_t t = tail.load(std::memory_order_acquire);
+    size_t h = head.load(std::memory_order_acquire);
+    return h - t;
+}
+
+IngestLane::IngestLane(std::unique_ptr<LineSource> lineSource, size_t ringLines, bool drop)
+    : source(std::move(lineSource)), ring(ringLines), dropWhenFull(drop) {
+}
+
+bool IngestLane::nextLine(std::string_view& line) {
+    // The previous line's slot is only given back now, so its view stayed
+    // valid until this call
+    if (holdingFront) {
+        ring.pop();
+        holdingFront = false;
+    }
+    holdingFront = ring.front(line);
+    return holdingFront;
+}
+
+IngestStats IngestLane::stats() const {
+    IngestStats s;
+    s.linesRead = read.load(std::memory_order_relaxed);
+    s.linesDropped = dropped.load(std::memory_order_relaxed);
+    s.linesTruncated = truncated.load(std::memory_order_relaxed);
+    s.linesPerSecond = rate.load(std::memory_order_relaxed);
+    s.queueDepth = ring.size();
+    s.queueCapacity = ring.capacity();
+    return s;
+}
+
+size_t IngestLane::pump() {
+    size_t moved = 0;
+
+    // Only look for new input once everything already read has been handed
+    // on; while the ring is full the rest simply waits in the file
+    if (sourceDry && (dropWhenFull || !ring.full())) {
+        source->poll();
+        sourceDry = false;
+    }
+
+    std::string_view line;
+    while (moved < pumpBatchLines && !sourceDry) {
+        if (!dropWhenFull && ring.full()) break;
+        if (!source->nextLine(line)) {
+            sourceDry = true;
+            break;
+        }
+        moved++;
+        if (line.size() > MAX_TEXT_BYTES) {
+            truncated.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (!ring.push(line)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    read.fetch_add(moved, std::memory_order_relaxed);
+    rateWindowLines += moved;
+    return moved;
+}
+
+void IngestLane::updateRate(double nowSeconds) {
+    double window = nowSeconds - rateWindowStart;
+    if (window <= 0.0) return;
+    rate.store(rateWindowLines / window, std::memory_order_relaxed);
+    rateWindowStart = nowSeconds;
+    rateWindowLines = 0;
+}
+
+// epoll tags for the two descriptors that aren't a lane's
+static const uint64_t inotifyTag = UINT64_MAX;
+static const uint64_t wakeTag = UINT64_MAX - 1;
+
+// Where a lane is in the reader thread's lists
+enum : uint8_t { laneIdle, laneReady, laneBlocked };
+
+static bool watchBefore(int directory, std::string_view name, int otherDirectory, std::string_view otherName) {
+    return directory != otherDirectory ? directory < otherDirectory : name < otherName;
+}
+
+IngestThread::IngestThread(int sleepMs) : idleSleepMs(sleepMs) {
+}
+
+IngestThread::~IngestThread() {
+    stop();
+}
+
+IngestLane& IngestThread::addLane(std::unique_ptr<LineSource> source, size_t ringLines, bool dropWhenFull) {
+    lanes.push_back(std::make_unique<IngestLane>(std::move(source), ringLines, dropWhenFull));
+    return *lanes.back();
+}
+
+void IngestThread::start() {
+    if (running.exchange(true)) return;
+    setUpWaits();
+    thread = std::thread(&IngestThread::run, this);
+}
+
+void IngestThread::stop() {
+    if (!running.exchange(false)) return;
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+    thread.join();
+    closeWaits();
+}
+
+void IngestThread::setUpWaits() {
+    armedFds.assign(lanes.size(), -1);
+    laneState.assign(lanes.size(), laneIdle);
+    ready.clear();
+    stillReady.clear();
+    polled.clear();
+    blocked.clear();
+    watches.clear();
+    ready.reserve(lanes.size());
+    stillReady.reserve(lanes.size());
+    polled.reserve(lanes.size());
+    blocked.reserve(lanes.size());
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epollFd < 0 || wakeFd < 0) {
+        std::cerr << "epoll unavailable (" << std::strerror(errno) << "); polling every source" << std::endl;
+        closeWaits();
+    } else {
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = wakeTag;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    }
+
+    for (size_t i = 0; i < lanes.size(); i++) {
+        LineSource& source = *lanes[i]->source;
+        bool waitable = false;
+        if (epollFd >= 0 && source.waitFd() >= 0) {
+            // One-shot: a lane that can't take more (full ring) mustn't keep
+            // waking the thread; it is re-armed once it has gone quiet
+            epoll_event event = {};
+            event.events = EPOLLIN | EPOLLONESHOT;
+            event.data.u64 = i;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, source.waitFd(), &event) == 0) {
+                armedFds[i] = source.waitFd();
+                waitable = true;
+            }
+        } else if (epollFd >= 0 && source.watchPath()) {
+            if (inotifyFd < 0) {
+                inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+                epoll_event event = {};
+                event.events = EPOLLIN;
+                event.data.u64 = inotifyTag;
+                if (inotifyFd >= 0) epoll_ctl(epollFd, EPOLL_CTL_ADD, inotifyFd, &event);
+            }
+            // Watch the directory, not the file: it sees the file being
+            // created, truncated or replaced as well as appended to
+            std::string path = source.watchPath();
+            size_t slash = path.rfind('/');
+            std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+            std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+            int wd = inotifyFd < 0 ? -1 : inotify_add_watch(inotifyFd, directory.c_str(),
+                                                            IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO);
+            if (wd >= 0) {
+                watches.push_back({ wd, name, i });
+                waitable = true;
+            }
+        }
+        if (!waitable) polled.push_back(i);
+        // Everything gets one look at the start, for input already there
+        markReady(i);
+    }
+    std::sort(watches.begin(), watches.end(), [](const FileWatch& a, const FileWatch& b) {
+        return watchBefore(a.directory, a.name, b.directory, b.name);
+    });
+}
+
+void IngestThread::closeWaits() {
+    if (inotifyFd >= 0) close(inotifyFd);
+    if (wakeFd >= 0) close(wakeFd);
+    if (epollFd >= 0) close(epollFd);
+    inotifyFd = wakeFd = epollFd = -1;
+}
+
+void IngestThread::markReady(size_t lane) {
+    // A blocked lane is looked at again once its ring has room, not sooner
+    if (laneState[lane] != laneIdle) return;
+    laneState[lane] = laneReady;
+    ready.push_back(lane);
+}
+
+void IngestThread::rearm(size_t lane) {
+    // A pipe that hit end of stream has closed its descriptor, which also
+    // took it out of the epoll set
+    int fd = armedFds[lane];
+    if (fd < 0) return;
+    if (lanes[lane]->source->waitFd() != fd) {
+        armedFds[lane] = -1;
+        return;
+    }
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.u64 = lane;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event);
+}
+
+void IngestThread::run() {
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    const double idleSeconds = idleSleepMs / 1000.0;
+    double lastSweep = 0.0;
+    double lastRate = 0.0;
+    while (running.load(std::memory_order_relaxed)) {
+        // One batch from each ready lane per pass, so they share the thread
+        for (size_t lane : ready) {
+            lanes[lane]->pump();
+            if (lanes[lane]->blocked()) {
+                blocked.push_back(lane);
+                laneState[lane] = laneBlocked;
+            } else if (!lanes[lane]->sourceDry) {
+                stillReady.push_back(lane);
+            } else {
+                rearm(lane);
+                laneState[lane] = laneIdle;
+            }
+        }
+        ready.swap(stillReady);
+        stillReady.clear();
+
+        // Lanes still busy mean no waiting, but changes on the others are
+        // still picked up
+        double now = std::chrono::duration<double>(Clock::now() - start).count();
+        bool sweepDue = now - lastSweep >= idleSeconds;
+        int timeout = -1;
+        if (!ready.empty() || sweepDue) {
+            timeout = 0;
+        } else if (!polled.empty() || !blocked.empty()) {
+            timeout = std::max(1, static_cast<int>((lastSweep + idleSeconds - now) * 1000.0 + 0.5));
+        }
+        waitForInput(timeout);
+
+        // Lanes nothing signals for, and full rings the game may have made
+        // room in, are looked at on a timer
+        now = std::chrono::duration<double>(Clock::now() - start).count();
+        if (now - lastSweep >= idleSeconds) {
+            lastSweep = now;
+            for (size_t lane : polled) markReady(lane);
+            for (size_t i = 0; i < blocked.size();) {
+                if (!lanes[blocked[i]]->blocked()) {
+                    laneState[blocked[i]] = laneIdle;
+                    markReady(blocked[i]);
+                    blocked[i] = blocked.back();
+                    blocked.pop_back();
+                } else {
+                    i++;
+                }
+            }
+        }
+        if (now - lastRate >= 1.0) {
+            lastRate = now;
+            for (auto& lane : lanes) lane->updateRate(now);
+        }
+    }
+}
+
+void IngestThread::waitForInput(int timeoutMs) {
+    if (epollFd < 0) {
+        if (timeoutMs != 0) std::this_thread::sleep_for(std::chrono::milliseconds(idleSleepMs));
+        return;
+    }
+    epoll_event events[64];
+    int count = epoll_wait(epollFd, events, 64, timeoutMs);
+    for (int i = 0; i < count; i++) {
+        uint64_t tag = events[i].data.u64;
+        if (tag == inotifyTag) {
+            readFileEvents();
+        } else if (tag == wakeTag) {
+            uint64_t value;
+            ssize_t got = read(wakeFd, &value, sizeof(value));
+            (void)got;
+        } else {
+            markReady(static_cast<size_t>(tag));
+        }
+    }
+}
+
+void IngestThread::readFileEvents() {
+    alignas(inotify_event) char buffer[16 * 1024];
+    while (true) {
+        ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) return;
+        for (ssize_t offset = 0; offset < length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost; every followed file takes a look
+                for (const FileWatch& watch : watches) markReady(watch.lane);
+                continue;
+            }
+            if (event->len == 0) continue;
+
+            // Files in the same directory are neighbours in the sorted list
+            std::string_view name(event->name);
+            auto first = std::lower_bound(watches.begin(), watches.end(), event->wd,
+                                          [&](const FileWatch& watch, int wd) {
+                                              return watchBefore(watch.directory, watch.name, wd, name);
+                                          });
+            for (auto it = first; it != watches.end() && it->directory == event->wd && it->name == name; ++it) {
+                markReady(it->lane);
+            }
+        }
+    }
+}
@@ -0,0 +1,164 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include "log_reader.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#define DEFAULT_INGEST_RING_LINES 1024
+
+// Bounded single-producer/single-consumer queue of lines. Each slot holds
+// up to MAX_TEXT_BYTES, the most a falling text ever displays, so the ring
+// is allocated once and pushing or popping never touches the heap. The two
+// indices live on separate cache lines and each side keeps a cached copy of
+// the other's index, so the threads only share a line when the ring looks
+// full or empty.
+class LineRing {
+public:
+    // capacity is rounded up to a power of two
+    explicit LineRing(size_t capacity);
+
+    LineRing(const LineRing&) = delete;
+    LineRing& operator=(const LineRing&) = delete;
+
+    // Producer side. Longer lines are cut to MAX_TEXT_BYTES.
+    bool full();
+    bool push(std::string_view line);
+
+    // Consumer side. The view stays valid until pop().
+    bool front(std::string_view& line);
+    void pop();
+
+    // Safe from either thread; may be stale by the time it returns
+    size_t size() const;
+    size_t capacity() const { return mask + 1; }
+
+private:
+    size_t mask;
+    size_t slotBytes;
+    std::vector<char> bytes;
+    std::vector<uint32_t> lengths;
+
+    alignas(64) std::atomic<size_t> head{0};  // next slot to write
+    size_t cachedTail = 0;                     // producer's view of tail
+    alignas(64) std::atomic<size_t> tail{0};  // next slot to read
+    size_t cachedHead = 0;                     // consumer's view of head
+};
+
+struct IngestStats {
+    uint64_t linesRead;       // lines taken from the source
+    uint64_t linesDropped;    // lost because the ring was full
+    uint64_t linesTruncated;  // longer than MAX_TEXT_BYTES
+    double linesPerSecond;    // over the last second
+    size_t queueDepth;
+    size_t queueCapacity;
+};
+
+// One lane's worth of ingest: the reader thread polls the source and pushes
+// into the ring, and the game pulls from it through the LineSource
+// interface. poll() does nothing here; the reader thread does that.
+class IngestLane : public LineSource {
+public:
+    // dropWhenFull: discard lines the game can't keep up with instead of
+    // leaving them in the source. Files should wait (the data is safe on
+    // disk); a live stream that must not stall its writer should drop.
+    IngestLane(std::unique_ptr<LineSource> source, size_t ringLines, bool dropWhenFull);
+
+    void poll() override {}
+    bool nextLine(std::string_view& line) override;
+
+    IngestStats stats() const;
+
+private:
+    friend class IngestThread;
+
+    // Reader thread: moves what it can from the source into the ring.
+    // Returns how many lines it took.
+    size_t pump();
+    // Reader thread: the lines/s figure, over the time since the last call
+    void updateRate(double nowSeconds);
+    // Reader thread: the ring is full and the source must wait for the game
+    bool blocked() { return !dropWhenFull && ring.full(); }
+
+    std::unique_ptr<LineSource> source;
+    LineRing ring;
+    bool dropWhenFull;
+    bool holdingFront = false;
+    bool sourceDry = true;  // last nextLine() came back empty
+
+    std::atomic<uint64_t> read{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> truncated{0};
+    std::atomic<double> rate{0.0};
+    double rateWindowStart = 0.0;
+    uint64_t rateWindowLines = 0;
+};
+
+// Owns the reader thread that feeds every lane, so the render thread only
+// ever pops from rings in memory and never waits on disk.
+//
+// The thread only touches lanes with something to do. Pipes are waited on
+// with epoll, and followed files through inotify watches on their
+// directories (which also see a log being recreated), all in one
+// epoll_wait; a change marks just that lane ready, so the work follows the
+// amount of new data rather than the number of sources. Lanes whose ring is
+// full, and sources with nothing to wait on, are looked at every
+// idleSleepMs. Without epoll or inotify, every lane is.
+class IngestThread {
+public:
+    explicit IngestThread(int idleSleepMs = 5);
+    ~IngestThread();
+
+    IngestThread(const IngestThread&) = delete;
+    IngestThread& operator=(const IngestThread&) = delete;
+
+    // Lanes must all be added before start()
+    IngestLane& addLane(std::unique_ptr<LineSource> source,
+                        size_t ringLines = DEFAULT_INGEST_RING_LINES, bool dropWhenFull = false);
+
+    void start();
+    void stop();
+
+    size_t laneCount() const { return lanes.size(); }
+    IngestLane& lane(size_t index) { return *lanes[index]; }
+
+private:
+    // A followed file, by the watch on its directory and its name there
+    struct FileWatch {
+        int directory;
+        std::string name;
+        size_t lane;
+    };
+
+    void setUpWaits();
+    void closeWaits();
+    void run();
+    void markReady(size_t lane);
+    void waitForInput(int timeoutMs);
+    void readFileEvents();
+    void rearm(size_t lane);
+
+    std::vector<std::unique_ptr<IngestLane>> lanes;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    int idleSleepMs;
+
+    int epollFd = -1;
+    int inotifyFd = -1;
+    int wakeFd = -1;                  // eventfd that stop() writes to
+    std::vector<FileWatch> watches;   // sorted by directory, then name
+    std::vector<int> armedFds;        // per lane: descriptor waited on, or -1
+    std::vector<size_t> ready;        // lanes to pump on the next pass
+    std::vector<size_t> stillReady;
+    std::vector<uint8_t> laneState;   // per lane
+    std::vector<size_t> polled;       // lanes nothing can signal
+    std::vector<size_t> blocked;      // lanes waiting on a full ring
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include "line_dedup.h"
+
+#include <cstdio>
+
+static const uint64_t fnvOffset = 0xCBF29CE484222325ull;
+static const uint64_t fnvPrime = 0x100000001B3ull;
+
+static inline uint64_t hashByte(uint64_t hash, unsigned char c) {
+    return (hash ^ c) * fnvPrime;
+}
+
+uint64_t hashLine(std::string_view line, uint64_t seed, bool normalize) {
+    uint64_t hash = hashByte(fnvOffset, static_cast<unsigned char>(seed)) ^ (seed << 8);
+    if (!normalize) {
+        for (char c : line) hash = hashByte(hash, static_cast<unsigned char>(c));
+        return hash;
+    }
+
+    // Tokens are hashed on their own and folded in at each space, so a
+    // '/' can throw away the directories read so far
+    uint64_t token = fnvOffset;
+    bool inDigits = false;
+    for (char ch : line) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        if (c == ' ' || c == '\t') {
+            hash = hashByte(hash ^ token, ' ');
+            token = fnvOffset;
+            inDigits = false;
+        } else if (c == '/' || c == '\\') {
+            token = fnvOffset;
+            inDigits = false;
+        } else if (c >= '0' && c <= '9') {
+            if (!inDigits) token = hashByte(token, '0');
+            inDigits = true;
+        } else {
+            token = hashByte(token, c);
+            inDigits = false;
+        }
+    }
+    return hashByte(hash ^ token, '\n');
+}
+
+size_t formatRepeatCount(uint32_t count, char* buffer, size_t size) {
+    int length = std::snprintf(buffer, size, " \xC3\x97%u", count);
+    if (length < 0) return 0;
+    return static_cast<size_t>(length) < size ? static_cast<size_t>(length) : size - 1;
+}
+
+static size_t powerOfTwoAtLeast(size_t count) {
+    size_t size = 1;
+    while (size < count) size <<= 1;
+    return size;
+}
+
+RepeatTable::RepeatTable(size_t slotCount, size_t handleCount)
+    : slots(powerOfTwoAtLeast(slotCount)), mask(slots.size() - 1), handleHashes(handleCount) {
+    clear();
+}
+
+uint32_t RepeatTable::find(uint64_t hash, const TextStore& texts) const {
+    const Slot& slot = slots[hash & mask];
+    if (slot.handle == TextArena::INVALID_HANDLE || slot.hash != hash) return TextArena::INVALID_HANDLE;
+    if (!texts.isLive(slot.handle) || handleHashes[slot.handle] != hash) return TextArena::INVALID_HANDLE;
+    return slot.handle;
+}
+
+void RepeatTable::remember(uint64_t hash, uint32_t handle) {
+    if (handle >= handleHashes.size()) return;
+    slots[hash & mask] = { hash, handle };
+    handleHashes[handle] = hash;
+}
+
+void RepeatTable::clear() {
+    for (Slot& slot : slots) slot = { 0, TextArena::INVALID_HANDLE };
+}
@@ -0,0 +1,61 @@
+#ifndef LINE_DEDUP_H
+#define LINE_DEDUP_H
+
+#include "text_store.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Recent lines remembered for merging; one per text the store can hold
+#define DEDUP_TABLE_SLOTS DEFAULT_TEXT_CAPACITY
+
+struct DedupConfig {
+    // A line repeating one still falling adds to that text's "×N" counter
+    // instead of spawning a copy
+    bool enabled = true;
+    // Counts lines as repeats when they differ only in directories and
+    // numbers ("src/a/x.cpp:12:" and "lib/x.cpp:40:" match); the text shown
+    // is the first one's
+    bool normalize = false;
+};
+
+struct DedupStats {
+    uint64_t linesMerged = 0;  // repeats that went into a counter
+    uint64_t bytesMerged = 0;  // their text, which would have been drawn
+};
+
+// Hash of a line in one pass over its bytes, seeded so equal lines from
+// different lanes differ. With normalize, each directory prefix of a token
+// is dropped as its '/' is reached, and a run of digits hashes as one '0'.
+uint64_t hashLine(std::string_view line, uint64_t seed, bool normalize);
+
+// " ×N" as drawn after a text that has repeated; returns the bytes written
+size_t formatRepeatCount(uint32_t count, char* buffer, size_t size);
+
+// Which falling text each recently spawned line became. Direct-mapped by
+// hash, so it is bounded and a newer line simply takes the slot of an
+// older one. Entries are checked against the store: a text that has fallen
+// off (or whose arena handle went to another line) is no longer a match.
+class RepeatTable {
+public:
+    explicit RepeatTable(size_t slotCount = DEDUP_TABLE_SLOTS, size_t handleCount = DEFAULT_TEXT_CAPACITY);
+
+    // Handle of the live text remembered for hash, or INVALID_HANDLE
+    uint32_t find(uint64_t hash, const TextStore& texts) const;
+    void remember(uint64_t hash, uint32_t handle);
+    void clear();
+
+private:
+    struct Slot {
+        uint64_t hash;
+        uint32_t handle;
+    };
+
+    std::vector<Slot> slots;
+    size_t mask;
+    // Hash each arena handle was last spawned with
+    std::vector<uint64_t> handleHashes;
+};
+
+#endif
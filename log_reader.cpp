@@ -0,0 +1,267 @@
+#include "log_reader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::vector<std::string> readAllLines(const std::string& filename) {
+    std::ifstream file(filename);
+    std::vector<std::string> lines;
+    std::string line;
+
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.find("//") != 0) {
+            lines.push_back(line);
+        }
+    }
+
+    return lines;
+}
+
+static bool keepLine(const char* data, size_t size) {
+    if (size == 0) return false;
+    return !(size >= 2 && data[0] == '/' && data[1] == '/');
+}
+
+void LineBuffer::push(const char* data, size_t length) {
+    lines.push_back({ bytes.size(), length });
+    bytes.append(data, length);
+}
+
+void LineBuffer::clear() {
+    partial.clear();
+    bytes.clear();
+    lines.clear();
+    head = 0;
+}
+
+void LineBuffer::compact() {
+    if (head == lines.size()) {
+        bytes.clear();
+        lines.clear();
+        head = 0;
+        return;
+    }
+    // Only shift once the consumed half dominates, so this stays amortised
+    size_t consumed = lines[head].offset;
+    if (consumed < bytes.size() / 2) return;
+
+    bytes.erase(0, consumed);
+    lines.erase(lines.begin(), lines.begin() + head);
+    head = 0;
+    for (auto& span : lines) span.offset -= consumed;
+}
+
+void LineBuffer::append(const char* data, size_t size) {
+    const char* end = data + size;
+    while (data < end) {
+        const char* newline = static_cast<const char*>(memchr(data, '\n', end - data));
+        if (!newline) {
+            partial.append(data, end);
+            return;
+        }
+        if (partial.empty()) {
+            if (keepLine(data, newline - data)) {
+                push(data, newline - data);
+            }
+        } else {
+            partial.append(data, newline);
+            if (keepLine(partial.data(), partial.size())) {
+                push(partial.data(), partial.size());
+            }
+            partial.clear();
+        }
+        data = newline + 1;
+    }
+}
+
+void LineBuffer::finish() {
+    if (keepLine(partial.data(), partial.size())) {
+        push(partial.data(), partial.size());
+    }
+    partial.clear();
+}
+
+bool LineBuffer::next(std::string_view& line) {
+    if (head == lines.size()) return false;
+
+    const Span& span = lines[head++];
+    line = std::string_view(bytes.data() + span.offset, span.length);
+    return true;
+}
+
+LogTail::LogTail(const std::string& path) : filePath(path) {
+    open();
+}
+
+LogTail::~LogTail() {
+    close();
+}
+
+bool LogTail::open() {
+    fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close();
+        return false;
+    }
+    device = st.st_dev;
+    inode = st.st_ino;
+    offset = 0;
+    return true;
+}
+
+void LogTail::close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+void LogTail::poll() {
+    resetFlag = false;
+    pending.compact();
+
+    // The build may not have created the file yet
+    if (fd < 0 && !open()) return;
+
+    // Detect the path now pointing at a different file, e.g. a fresh build
+    // that recreated the log
+    struct stat pathStat;
+    if (stat(filePath.c_str(), &pathStat) == 0 &&
+        (pathStat.st_dev != device || pathStat.st_ino != inode)) {
+        close();
+        resetFlag = true;
+        pending.clear();
+        if (!open()) return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) return;
+    if (st.st_size < offset) {
+        // Truncated in place (e.g. "2>stderr.log" reopening the file)
+        offset = 0;
+        resetFlag = true;
+        pending.clear();
+    }
+    if (st.st_size == offset) return;
+
+    char buffer[64 * 1024];
+    while (true) {
+        ssize_t n = pread(fd, buffer, sizeof(buffer), offset);
+        if (n <= 0) break;
+        offset += n;
+        pending.append(buffer, static_cast<size_t>(n));
+    }
+}
+
+bool LogTail::nextLine(std::string_view& line) {
+    return pending.next(line);
+}
+
+PipeSource::PipeSource(int pipeFd) : fd(pipeFd) {
+    if (fd >= 0) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+PipeSource::~PipeSource() {
+    if (fd >= 0) ::close(fd);
+}
+
+void PipeSource::poll() {
+    pending.compact();
+    if (fd < 0) return;
+
+    char buffer[64 * 1024];
+    while (true) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            pending.append(buffer, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        // End of stream (or an error we can't recover from)
+        pending.finish();
+        ::close(fd);
+        fd = -1;
+        return;
+    }
+}
+
+bool PipeSource::nextLine(std::string_view& line) {
+    return pending.next(line);
+}
+
+// Lines indexed per refill, and how much consumed data to accumulate before
+// dropping it from the page cache mapping
+static const size_t MAPPED_INDEX_CHUNK = 4096;
+static const uint64_t MAPPED_RELEASE_BYTES = 16ull << 20;
+
+MappedLog::MappedLog(const std::string& path) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) return;
+    size = static_cast<uint64_t>(st.st_size);
+    if (size == 0) return;
+
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        size = 0;
+        return;
+    }
+    data = static_cast<const char*>(mapping);
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    lineStarts.reserve(MAPPED_INDEX_CHUNK);
+}
+
+MappedLog::~MappedLog() {
+    if (data) munmap(const_cast<char*>(data), size);
+    if (fd >= 0) ::close(fd);
+}
+
+size_t MappedLog::indexAhead(size_t maxLines) {
+    // Drop the consumed part of the window before growing it
+    if (indexHead > 0) {
+        lineStarts.erase(lineStarts.begin(), lineStarts.begin() + indexHead);
+        indexHead = 0;
+    }
+
+    size_t added = 0;
+    while (added < maxLines && scanOffset < size) {
+        const char* start = data + scanOffset;
+        const char* newline = static_cast<const char*>(memchr(start, '\n', size - scanOffset));
+        uint64_t length = newline ? static_cast<uint64_t>(newline - start) : size - scanOffset;
+        if (keepLine(start, length)) {
+            lineStarts.push_back(scanOffset);
+            added++;
+        }
+        scanOffset += length + 1;
+    }
+    return added;
+}
+
+void MappedLog::releaseConsumed(uint64_t upTo) {
+    long pageSize = sysconf(_SC_PAGESIZE);
+    uint64_t end = upTo & ~static_cast<uint64_t>(pageSize - 1);
+    if (end <= releasedOffset) return;
+    madvise(const_cast<char*>(data) + releasedOffset, end - releasedOffset, MADV_DONTNEED);
+    releasedOffset = end;
+}
+
+bool MappedLog::nextLine(std::string_view& line) {
+    if (indexHead == lineStarts.size() && indexAhead(MAPPED_INDEX_CHUNK) == 0) return false;
+
+    uint64_t start = lineStarts[indexHead++];
+    const char* begin = data + start;
+    const char* newline = static_cast<const char*>(memchr(begin, '\n', size - start));
+    line = std::string_view(begin, newline ? static_cast<size_t>(newline - begin) : size - start);
+
+    if (start - releasedOffset >= MAPPED_RELEASE_BYTES) releaseConsumed(start);
+    return true;
+}
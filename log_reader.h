@@ -0,0 +1,161 @@
+#ifndef LOG_READER_H
+#define LOG_READER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/types.h>
+
+// Reads the whole file and returns its non-empty lines that don't start
+// with "//".
+std::vector<std::string> readAllLines(const std::string& filename);
+
+// A stream of log lines feeding one lane of falling text. Lines are
+// filtered the same way as readAllLines.
+class LineSource {
+public:
+    virtual ~LineSource() = default;
+
+    // Picks up any new input. Cheap when nothing has changed.
+    virtual void poll() = 0;
+
+    // Hands out the next pending line. The view stays valid until the next
+    // call on this source, so callers copy it only if they keep it.
+    virtual bool nextLine(std::string_view& line) = 0;
+
+    // A descriptor that turns readable when poll() would find new input, so
+    // a reader can sleep in poll(2) instead of spinning; -1 if there is none.
+    virtual int waitFd() const { return -1; }
+
+    // A file whose changes (inotify) mean poll() would find new input, for
+    // sources that have no descriptor to wait on; null if there is none.
+    virtual const char* watchPath() const { return nullptr; }
+};
+
+// Splits a byte stream into filtered lines. A trailing line without its
+// '\n' is held back until the rest of it arrives. Pending lines are packed
+// into one reused buffer, so once it has grown to the usual backlog size
+// appending no longer allocates.
+class LineBuffer {
+public:
+    void append(const char* data, size_t size);
+    // Emits the held-back partial line, for a stream that has ended
+    void finish();
+    bool next(std::string_view& line);
+
+    // Drops consumed lines; call when no view from next() is still in use
+    void compact();
+    void clear();
+
+    size_t pendingCount() const { return lines.size() - head; }
+
+private:
+    void push(const char* data, size_t length);
+
+    // size_t, not uint32_t: the first poll() of a large existing log reads
+    // it to the end in one go, which can pass 4 GiB
+    struct Span {
+        size_t offset;
+        size_t length;
+    };
+
+    std::string partial;
+    std::string bytes;
+    std::vector<Span> lines;
+    size_t head = 0;
+};
+
+// Follows a growing log file like `tail -F`. Each poll() only parses the
+// bytes appended since the previous call. If the file shrinks or is
+// replaced by a different file (new inode) the reader starts over from
+// byte 0 of the new contents and drops lines still pending from the old one.
+class LogTail : public LineSource {
+public:
+    explicit LogTail(const std::string& path);
+    ~LogTail() override;
+
+    LogTail(const LogTail&) = delete;
+    LogTail& operator=(const LogTail&) = delete;
+
+    void poll() override;
+    bool nextLine(std::string_view& line) override;
+    const char* watchPath() const override { return filePath.c_str(); }
+
+    // True if the last poll() found the file truncated or replaced.
+    bool wasReset() const { return resetFlag; }
+
+    size_t pendingCount() const { return pending.pendingCount(); }
+    const std::string& path() const { return filePath; }
+
+private:
+    bool open();
+    void close();
+
+    std::string filePath;
+    int fd = -1;
+    dev_t device = 0;
+    ino_t inode = 0;
+    off_t offset = 0;
+    LineBuffer pending;
+    bool resetFlag = false;
+};
+
+// Reads lines from the read end of a pipe (or any stream descriptor) without
+// ever blocking. Takes ownership of fd. At end of stream a final line with
+// no '\n' is still handed out.
+class PipeSource : public LineSource {
+public:
+    explicit PipeSource(int fd);
+    ~PipeSource() override;
+
+    PipeSource(const PipeSource&) = delete;
+    PipeSource& operator=(const PipeSource&) = delete;
+
+    void poll() override;
+    bool nextLine(std::string_view& line) override;
+    int waitFd() const override { return fd; }
+
+    // The writer has closed its end and everything has been read
+    bool finished() const { return fd < 0; }
+
+private:
+    int fd;
+    LineBuffer pending;
+};
+
+// Replays an archived log straight out of a read-only memory mapping.
+// Line starts are indexed a chunk at a time just ahead of the reader and
+// pages already consumed are handed back to the kernel, so load time and
+// resident memory stay flat no matter how large the file is. Lines are
+// returned as views into the mapping and are never copied here.
+class MappedLog : public LineSource {
+public:
+    explicit MappedLog(const std::string& path);
+    ~MappedLog() override;
+
+    MappedLog(const MappedLog&) = delete;
+    MappedLog& operator=(const MappedLog&) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+
+    void poll() override {}
+    bool nextLine(std::string_view& line) override;
+
+    // Number of lines indexed but not yet handed out.
+    size_t pendingCount() const { return lineStarts.size() - indexHead; }
+
+private:
+    size_t indexAhead(size_t maxLines);
+    void releaseConsumed(uint64_t upTo);
+
+    int fd = -1;
+    const char* data = nullptr;
+    uint64_t size = 0;
+    uint64_t scanOffset = 0;
+    uint64_t releasedOffset = 0;
+    std::vector<uint64_t> lineStarts;
+    size_t indexHead = 0;
+};
+
+#endif
@@ -1,35 +1,66 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
-#include <ft2build.h>
-#include FT_FREETYPE_H
+#include "text_renderer.h"
+#include "log_reader.h"
+#include "simulation.h"
+#include "alloc_counter.h"
+#include "build_process.h"
+#include "compressed_log.h"
+#include "frame_pacer.h"
+#include "gpu_timer.h"
+#include "hud_renderer.h"
+#include "ingest.h"
+#include "profiler.h"
+#include "render_bench.h"
+#include "trace.h"
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <cmath>
 #include <map>
 #include <vector>
 #include <string>
-#include <fstream>
+#include <memory>
+#include <string_view>
 #include <algorithm>
+#include <chrono>
+#include <sys/wait.h>
 
-#define SCREEN_X_PIXELS 1200.0f
-#define SCREEN_Y_PIXELS 1200.0f
-
-// Vertex shader source code
+// HUD vertex shader: one unit quad, instanced once per HUD rectangle. The
+// player and health bar instances pick up this frame's values from uniforms.
 const char* vertexShaderSource = R"(
 #version 330 core
 layout (location = 0) in vec2 aPos;
-uniform vec2 offset;
+layout (location = 1) in vec4 instanceRect;
+layout (location = 2) in vec3 instanceColor;
+layout (location = 3) in float instanceRole;
+uniform vec2 playerOffset;
+uniform vec3 playerColor;
+uniform float health;
+uniform vec3 healthColor;
+out vec3 quadColor;
 void main() {
-    gl_Position = vec4(aPos.x + offset.x, aPos.y + offset.y, 0.0, 1.0);
+    vec2 origin = instanceRect.xy;
+    vec2 size = instanceRect.zw;
+    quadColor = instanceColor;
+    if (instanceRole == 1.0) {
+        origin += playerOffset;
+        quadColor = playerColor;
+    } else if (instanceRole == 2.0) {
+        size.x *= health;
+        quadColor = healthColor;
+    }
+    gl_Position = vec4(origin + aPos * size, 0.0, 1.0);
 }
 )";
 
-// Fragment shader source code
+// HUD fragment shader
 const char* fragmentShaderSource = R"(
 #version 330 core
+in vec3 quadColor;
 out vec4 FragColor;
-uniform vec3 color;
 void main() {
-    FragColor = vec4(color, 1.0);
+    FragColor = vec4(quadColor, 1.0);
 }
 )";
 
@@ -37,63 +68,43 @@ void main() {
 const char* textVertexShaderSource = R"(
 #version 330 core
 layout (location = 0) in vec4 vertex;
-out vec2 TexCoords;
+layout (location = 1) in float vertexPage;
+layout (location = 2) in vec3 vertexColor;
+out vec3 TexCoords;
+out vec3 TextColor;
 uniform mat4 projection;
 void main() {
     gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
-    TexCoords = vertex.zw;
+    TexCoords = vec3(vertex.zw, vertexPage);
+    TextColor = vertexColor;
 }
 )";
 
 // Text fragment shader
 const char* textFragmentShaderSource = R"(
 #version 330 core
-in vec2 TexCoords;
+in vec3 TexCoords;
+in vec3 TextColor;
 out vec4 color;
-uniform sampler2D text;
-uniform vec3 textColor;
+uniform sampler2DArray text;
 void main() {
     vec4 sampled = vec4(1.0, 1.0, 1.0, texture(text, TexCoords).r);
-    color = vec4(textColor, 1.0) * sampled;
+    color = vec4(TextColor, 1.0) * sampled;
 }
 )";
 
-struct Character {
-    unsigned int TextureID;
-    int SizeX, SizeY;
-    int BearingX, BearingY;
-    unsigned int Advance;
-};
-
-struct FallingText {
-    std::string text;
-    float x;
-    float y;
-    float speed;
-    float r, g, b;
-};
-
-std::map<char, Character> Characters;
-std::vector<FallingText> fallingTexts;
+const char* windowTitle = "ClaudeGame - Border Renderer";
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
 }
 
-void processInput(GLFWwindow* window, float& playerX, float deltaTime) {
+void processInput(GLFWwindow* window, SimInput& input) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    float moveSpeed = 1.0f;
-    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-        playerX -= moveSpeed * deltaTime;
-    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-        playerX += moveSpeed * deltaTime;
-
-    // Clamp player position to stay within bounds
-    float maxX = 0.7f;
-    if (playerX < -maxX) playerX = -maxX;
-    if (playerX > maxX) playerX = maxX;
+    input.moveLeft = glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS;
+    input.moveRight = glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS;
 }
 
 unsigned int compileShader(unsigned int type, const char* source) {
@@ -157,124 +168,161 @@ unsigned int createTextShaderProgram() {
     return shaderProgram;
 }
 
-std::vector<std::string> readAllLines(const std::string& filename) {
-    std::ifstream file(filename);
-    std::vector<std::string> lines;
-    std::string line;
-
-    while (std::getline(file, line)) {
-        if (!line.empty() && line.find("//") != 0) {
-            lines.push_back(line);
-        }
+// Time spent in each stage from launch to the first frame on screen
+class StartupTimer {
+public:
+    void mark(const char* stage, const char* detail = "") {
+        Clock::time_point now = Clock::now();
+        double ms = std::chrono::duration<double, std::milli>(now - last).count();
+        last = now;
+        int length = std::snprintf(report + used, sizeof(report) - used, "%s%s %.1f ms%s",
+                                   used > 0 ? ", " : "", stage, ms, detail);
+        if (length > 0) used = std::min(sizeof(report) - 1, used + static_cast<size_t>(length));
     }
 
-    return lines;
-}
-
-std::string getNextLine(const std::vector<std::string>& lines, int& currentIndex) {
-    if (lines.empty()) return "";
-
-    if (currentIndex >= lines.size()) return "";
+    void print() const {
+        double total = std::chrono::duration<double, std::milli>(last - start).count();
+        std::cout << "Startup: " << report << "; total " << total << " ms" << std::endl;
+    }
 
-    std::string result = lines[currentIndex];
+private:
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    Clock::time_point last = start;
+    char report[512] = {};
+    size_t used = 0;
+};
 
-    currentIndex = (currentIndex + 1);
-    return result;
-}
+using CompressedLogList = std::vector<std::pair<std::string, const CompressedLog*>>;
 
-float getTextWidth(const std::string& text, float scale) {
-    float width = 0.0f;
-    for (char c : text) {
-        if (Characters.find(c) != Characters.end()) {
-            Character ch = Characters[c];
-            width += (ch.Advance >> 6) * scale;
+// Compressed logs are archives whatever the flags say, and are streamed
+// through a decoder instead of mapped or followed
+std::unique_ptr<LineSource> openLineSource(const std::string& path, bool useMmap,
+                                           CompressedLogList& compressedLogs) {
+    if (detectCompression(path) != Compression::None) {
+        auto compressed = std::make_unique<CompressedLog>(path, false);
+        if (compressed->isOpen()) compressedLogs.emplace_back(path, compressed.get());
+        return compressed;
+    }
+    if (useMmap) {
+        auto mapped = std::make_unique<MappedLog>(path);
+        if (!mapped->isOpen()) {
+            std::cerr << "Failed to map " << path << std::endl;
         }
+        return mapped;
     }
-    return width;
-}
-
-float getTextHeight(float scale) {
-    return 48.0f * scale;
-}
-
-bool checkCollision(float playerX, float playerY, float playerSize,
-                    float textX, float textY, const std::string& text, float textScale) {
-    // Convert player square from normalized coords to pixel coords
-    float playerPixelX = (playerX * SCREEN_Y_PIXELS/2.0f) + SCREEN_Y_PIXELS/2.0f;
-    float playerPixelY = (playerY * SCREEN_Y_PIXELS/2.0f) + SCREEN_Y_PIXELS/2.0f;
-    float playerPixelSize = playerSize * SCREEN_Y_PIXELS/2.0f;
-
-    // Player square bounds in pixel coords
-    float playerLeft = playerPixelX - playerPixelSize;
-    float playerRight = playerPixelX + playerPixelSize;
-    float playerTop = playerPixelY - playerPixelSize;
-    float playerBottom = playerPixelY + playerPixelSize;
-
-    // Text bounds in pixel coords
-    float textWidth = getTextWidth(text, textScale);
-    float textHeight = getTextHeight(textScale);
-    float textLeft = textX;
-    float textRight = textX + textWidth;
-    float textTop = textY;
-    float textBottom = textY + textHeight;
-
-    // AABB collision detection
-    return playerLeft < textRight &&
-           playerRight > textLeft &&
-           playerTop < textBottom &&
-           playerBottom > textTop;
-}
-
-void renderText(unsigned int shader, unsigned int VAO, unsigned int VBO,
-                const std::string& text, float x, float y, float scale,
-                float r, float g, float b) {
-    glUseProgram(shader);
-    glUniform3f(glGetUniformLocation(shader, "textColor"), r, g, b);
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(VAO);
-
-    float currentX = x;
-    for (char c : text) {
-        if (Characters.find(c) == Characters.end()) continue;
-
-        Character ch = Characters[c];
-
-        float xpos = currentX + ch.BearingX * scale;
-        float ypos = y - (ch.SizeY - ch.BearingY) * scale;
-        float w = ch.SizeX * scale;
-        float h = ch.SizeY * scale;
-
-        float vertices[6][4] = {
-            { xpos,     ypos + h,   0.0f, 0.0f },
-            { xpos,     ypos,       0.0f, 1.0f },
-            { xpos + w, ypos,       1.0f, 1.0f },
-            { xpos,     ypos + h,   0.0f, 0.0f },
-            { xpos + w, ypos,       1.0f, 1.0f },
-            { xpos + w, ypos + h,   1.0f, 0.0f }
-        };
-
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        currentX += (ch.Advance >> 6) * scale;
-    }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    return std::make_unique<LogTail>(path);
 }
 
 int main(int argc, char* argv[]) {
+    StartupTimer startup;
+
     // Check command line arguments
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <red_text_file> <green_text_file>" << std::endl;
+    bool useMmap = false;
+    std::string profilePath;
+    std::string classifyPath;
+    DedupConfig dedup;
+    std::string buildCommand;
+    double buildTimeout = 0.0;
+    size_t glyphBudgetBytes = DEFAULT_GLYPH_BUDGET_BYTES;
+    std::string recordPath;
+    std::string replayPath;
+    bool benchRender = false;
+    size_t benchTexts = DEFAULT_BENCH_TEXTS;
+    size_t benchFrames = DEFAULT_BENCH_FRAMES;
+    double targetFps = DEFAULT_TARGET_FPS;
+    double idleFps = DEFAULT_IDLE_FPS;
+    bool vsync = true;
+    // Files in the order given, plain or as --lane specs, and their lanes
+    std::vector<std::string> files;
+    std::vector<SourceLane> laneConfigs;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--mmap") {
+            useMmap = true;
+        } else if (arg == "--profile" && i + 1 < argc) {
+            profilePath = argv[++i];
+        } else if (arg == "--classify" && i + 1 < argc) {
+            classifyPath = argv[++i];
+        } else if (arg == "--no-dedup") {
+            dedup.enabled = false;
+        } else if (arg == "--dedup-normalize") {
+            dedup.normalize = true;
+        } else if (arg == "--build" && i + 1 < argc) {
+            buildCommand = argv[++i];
+        } else if (arg == "--build-timeout" && i + 1 < argc) {
+            buildTimeout = std::atof(argv[++i]);
+        } else if (arg == "--glyph-budget" && i + 1 < argc) {
+            glyphBudgetBytes = static_cast<size_t>(std::atof(argv[++i]) * 1024 * 1024);
+        } else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (arg == "--fps" && i + 1 < argc) {
+            targetFps = std::atof(argv[++i]);
+        } else if (arg == "--idle-fps" && i + 1 < argc) {
+            idleFps = std::atof(argv[++i]);
+        } else if (arg == "--no-vsync") {
+            vsync = false;
+        } else if (arg == "--bench-render") {
+            benchRender = true;
+        } else if (arg == "--bench-texts" && i + 1 < argc) {
+            benchTexts = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (arg == "--bench-frames" && i + 1 < argc) {
+            benchFrames = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (arg == "--lane" && i + 1 < argc) {
+            std::string path;
+            SourceLane lane = defaultSourceLane(files.size());
+            if (!parseLaneSpec(argv[++i], path, lane)) {
+                return -1;
+            }
+            files.push_back(path);
+            laneConfigs.push_back(lane);
+        } else {
+            files.push_back(arg);
+            laneConfigs.push_back(defaultSourceLane(laneConfigs.size()));
+        }
+    }
+    bool replaying = !replayPath.empty();
+    // Without a session to replay, the render bench draws made-up lines
+    bool synthetic = benchRender && !replaying;
+    bool offscreen = replaying || benchRender;
+    bool sourcesGiven = replaying || synthetic ? files.empty() && buildCommand.empty()
+                        : buildCommand.empty() ? !files.empty() && files.size() <= MAX_SOURCE_LANES
+                                               : files.empty();
+    if (!sourcesGiven || targetFps < 0.0 || idleFps <= 0.0) {
+        std::cerr << "Usage: " << argv[0] << " [--mmap] [--fps N] [--idle-fps N] [--no-vsync] [--profile TRACE.json] [--classify PATTERNS] [--no-dedup] [--dedup-normalize] [--glyph-budget MB] [--record SESSION] <red_text_file> [<green_text_file> ...] [--lane LANE ...]" << std::endl;
+        std::cerr << "       " << argv[0] << " [--profile TRACE.json] [--classify PATTERNS] [--glyph-budget MB] [--record SESSION] --build COMMAND [--build-timeout SECONDS]" << std::endl;
+        std::cerr << "       " << argv[0] << " [--profile TRACE.json] [--classify PATTERNS] [--bench-render] --replay SESSION" << std::endl;
+        std::cerr << "       " << argv[0] << " --bench-render [--bench-texts N] [--bench-frames FRAMES]" << std::endl;
         std::cerr << "Example: " << argv[0] << " test_text.cpp test_text2.cpp" << std::endl;
+        std::cerr << "         " << argv[0] << " build/errors.log build/out.log --lane \"build/link.log,category=warning,color=ff8800,weight=2\"" << std::endl;
+        std::cerr << "         " << argv[0] << " --build \"bash compile_gambit.sh\" --build-timeout 100" << std::endl;
+        std::cerr << "  --mmap     replay finished (archived) logs from a memory mapping" << std::endl;
+        std::cerr << "             gzip (and zstd, if built with it) logs are always replayed, decompressed as read" << std::endl;
+        std::cerr << "  files      each file is a lane of its own: the first red, where unmatched lines count as" << std::endl;
+        std::cerr << "             errors, the rest in other colours; lanes take turns spawning" << std::endl;
+        std::cerr << "  --lane     a file with its own look: PATH[,category=NAME][,color=RRGGBB][,weight=N], where" << std::endl;
+        std::cerr << "             category is what unmatched lines count as and weight its share of the spawns" << std::endl;
+        std::cerr << "  --fps      frames drawn per second at most (default " << DEFAULT_TARGET_FPS << ", 0 for no cap); the game" << std::endl;
+        std::cerr << "             itself always steps at " << 1.0 / FIXED_TIMESTEP_SECONDS << " Hz" << std::endl;
+        std::cerr << "  --idle-fps frames per second while nothing is falling (default " << DEFAULT_IDLE_FPS << ")" << std::endl;
+        std::cerr << "  --no-vsync pace frames by sleeping alone, without waiting for the display" << std::endl;
+        std::cerr << "  --profile  write per-phase timings as a Chrome trace and print frame-time percentiles" << std::endl;
+        std::cerr << "  --classify tag lines by the patterns in PATTERNS instead of the built-in gcc/make set" << std::endl;
+        std::cerr << "  --no-dedup spawn every repeat of a falling line instead of counting it on that text" << std::endl;
+        std::cerr << "  --dedup-normalize  count lines differing only in directories and numbers as repeats" << std::endl;
+        std::cerr << "  --glyph-budget MB  texture memory for glyphs (default 4); least recently drawn pages are reused" << std::endl;
+        std::cerr << "  --build    run COMMAND and play its stderr (red) and stdout (green) as they arrive;" << std::endl;
+        std::cerr << "             the build is stopped when the game closes or the timeout runs out" << std::endl;
+        std::cerr << "  --record   write every step's timestep and keys, and the lines it took, to SESSION" << std::endl;
+        std::cerr << "  --replay   play SESSION back in a hidden window as fast as it will render, then exit" << std::endl;
+        std::cerr << "  --bench-render  draw offscreen with vsync off and report frame-time percentiles and GL" << std::endl;
+        std::cerr << "             calls per frame, for N made-up texts (default " << DEFAULT_BENCH_TEXTS << ") over FRAMES frames" << std::endl;
+        std::cerr << "             (default " << DEFAULT_BENCH_FRAMES << "), or for every frame of a --replay SESSION" << std::endl;
         return -1;
     }
 
-    std::string redTextFile = argv[1];
-    std::string greenTextFile = argv[2];
-
     // Initialize GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -289,9 +337,13 @@ int main(int argc, char* argv[]) {
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+    // A replay or render bench draws every frame but shows none of them
+    if (offscreen) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
 
     // Create window
-    GLFWwindow* window = glfwCreateWindow(SCREEN_X_PIXELS, SCREEN_Y_PIXELS, "ClaudeGame - Border Renderer", nullptr, nullptr);
+    GLFWwindow* window = glfwCreateWindow(SCREEN_X_PIXELS, SCREEN_Y_PIXELS, windowTitle, nullptr, nullptr);
     if (window == nullptr) {
         std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -299,6 +351,12 @@ int main(int argc, char* argv[]) {
     }
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    // Offscreen runs go as fast as they can; on screen the swap waits for
+    // the display unless told not to
+    glfwSwapInterval(!offscreen && vsync ? 1 : 0);
+    const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    FramePacer pacer(offscreen ? 0.0 : targetFps, idleFps, !offscreen && vsync,
+                     videoMode ? videoMode->refreshRate : 0.0);
 
     // Initialize GLEW
     glewExperimental = GL_TRUE;
@@ -311,82 +369,32 @@ int main(int argc, char* argv[]) {
     // Enable blending for text rendering
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    startup.mark("window");
 
-    // Initialize FreeType
-    FT_Library ft;
-    if (FT_Init_FreeType(&ft)) {
-        std::cerr << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+    // Glyphs are rasterized the first time a text uses them, and kept on
+    // disk for the next start, which then needn't touch FreeType at all
+    if (!glyphCache.open(FONT_PATH, FONT_PIXEL_HEIGHT, glyphBudgetBytes)) {
+        glfwTerminate();
         return -1;
     }
-
-    // Load font
-    FT_Face face;
-    if (FT_New_Face(ft, "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", 0, &face)) {
-        std::cerr << "ERROR::FREETYPE: Failed to load font" << std::endl;
-        return -1;
+    const std::string glyphCachePath = glyphCache.cacheFilePath();
+    char glyphDetail[64];
+    if (glyphCache.load(glyphCachePath)) {
+        std::snprintf(glyphDetail, sizeof(glyphDetail), " (warm, %llu cached)",
+                      static_cast<unsigned long long>(glyphCache.stats().glyphsCached));
+    } else {
+        std::snprintf(glyphDetail, sizeof(glyphDetail), " (cold)");
     }
-
-    FT_Set_Pixel_Sizes(face, 0, 48);
-
-    // Disable byte-alignment restriction
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-    // Load first 128 ASCII characters
-    for (unsigned char c = 0; c < 128; c++) {
-        if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
-            std::cerr << "ERROR::FREETYPE: Failed to load Glyph " << c << std::endl;
-            continue;
-        }
-
-        unsigned int texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RED,
-            face->glyph->bitmap.width,
-            face->glyph->bitmap.rows,
-            0,
-            GL_RED,
-            GL_UNSIGNED_BYTE,
-            face->glyph->bitmap.buffer
-        );
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        Character character = {
-            texture,
-            static_cast<int>(face->glyph->bitmap.width),
-            static_cast<int>(face->glyph->bitmap.rows),
-            face->glyph->bitmap_left,
-            face->glyph->bitmap_top,
-            static_cast<unsigned int>(face->glyph->advance.x)
-        };
-        Characters.insert(std::pair<char, Character>(c, character));
-    }
-
-    FT_Done_Face(face);
-    FT_Done_FreeType(ft);
+    startup.mark("glyph cache", glyphDetail);
 
     // Create shader programs
     unsigned int shaderProgram = createShaderProgram();
     unsigned int textShaderProgram = createTextShaderProgram();
 
-    // Setup text rendering VAO and VBO
-    unsigned int textVAO, textVBO;
-    glGenVertexArrays(1, &textVAO);
-    glGenBuffers(1, &textVBO);
-    glBindVertexArray(textVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    // Setup batched text rendering against the glyph atlas
+    TextBatch textBatch;
+    textBatch.init(textShaderProgram);
+    textBatch.uploadGlyphPages();
 
     // Setup orthographic projection for text
     float projection[16] = {
@@ -398,344 +406,441 @@ int main(int argc, char* argv[]) {
     glUseProgram(textShaderProgram);
     glUniformMatrix4fv(glGetUniformLocation(textShaderProgram, "projection"), 1, GL_FALSE, projection);
 
-    // Define vertices for outer square (border)
+    // HUD rectangles, back to front, in normalized device coordinates
     float outerSize = 0.8f;
-    float outerVertices[] = {
-        -outerSize, -outerSize,  // bottom left
-         outerSize, -outerSize,  // bottom right
-         outerSize,  outerSize,  // top right
-        -outerSize,  outerSize   // top left
-    };
-
-    // Define vertices for inner square (black center)
     float borderThickness = 0.05f;
     float innerSize = outerSize - borderThickness;
-    float innerVertices[] = {
-        -innerSize, -innerSize,  // bottom left
-         innerSize, -innerSize,  // bottom right
-         innerSize,  innerSize,  // top right
-        -innerSize,  innerSize   // top left
-    };
-
-    // Indices for drawing squares
-    unsigned int indices[] = {
-        0, 1, 2,
-        2, 3, 0
-    };
-
-    // Setup outer square VAO and VBO
-    unsigned int outerVAO, outerVBO, outerEBO;
-    glGenVertexArrays(1, &outerVAO);
-    glGenBuffers(1, &outerVBO);
-    glGenBuffers(1, &outerEBO);
-
-    glBindVertexArray(outerVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, outerVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(outerVertices), outerVertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, outerEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // Setup inner square VAO and VBO
-    unsigned int innerVAO, innerVBO, innerEBO;
-    glGenVertexArrays(1, &innerVAO);
-    glGenBuffers(1, &innerVBO);
-    glGenBuffers(1, &innerEBO);
-
-    glBindVertexArray(innerVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, innerVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(innerVertices), innerVertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, innerEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // Define vertices for player square (small grey square)
     float playerSize = 0.05f;
-    float playerVertices[] = {
-        -playerSize, -playerSize,  // bottom left
-         playerSize, -playerSize,  // bottom right
-         playerSize,  playerSize,  // top right
-        -playerSize,  playerSize   // top left
-    };
-
-    // Setup player square VAO and VBO
-    unsigned int playerVAO, playerVBO, playerEBO;
-    glGenVertexArrays(1, &playerVAO);
-    glGenBuffers(1, &playerVBO);
-    glGenBuffers(1, &playerEBO);
-
-    glBindVertexArray(playerVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, playerVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(playerVertices), playerVertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, playerEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // Define vertices for health bar background (at top of screen)
     float healthBarBgWidth = 0.6f;
     float healthBarBgHeight = 0.05f;
     float healthBarBgY = 0.85f;
-    float healthBarBgVertices[] = {
-        -healthBarBgWidth, healthBarBgY - healthBarBgHeight,  // bottom left
-         healthBarBgWidth, healthBarBgY - healthBarBgHeight,  // bottom right
-         healthBarBgWidth, healthBarBgY + healthBarBgHeight,  // top right
-        -healthBarBgWidth, healthBarBgY + healthBarBgHeight   // top left
+    std::vector<HudQuad> hudQuads = {
+        // Outer square (white border) and inner square (black center)
+        { -outerSize, -outerSize, 2.0f * outerSize, 2.0f * outerSize, { 1.0f, 1.0f, 1.0f }, HudRole::Static },
+        { -innerSize, -innerSize, 2.0f * innerSize, 2.0f * innerSize, { 0.0f, 0.0f, 0.0f }, HudRole::Static },
+        // Player square, centred on the player position
+        { -playerSize, -playerSize, 2.0f * playerSize, 2.0f * playerSize, { 0.5f, 0.5f, 0.5f }, HudRole::Player },
+        // Health bar background (dark grey) and foreground, at the top
+        { -healthBarBgWidth, healthBarBgY - healthBarBgHeight, 2.0f * healthBarBgWidth, 2.0f * healthBarBgHeight,
+          { 0.2f, 0.2f, 0.2f }, HudRole::Static },
+        { -healthBarBgWidth, healthBarBgY - healthBarBgHeight, 2.0f * healthBarBgWidth, 2.0f * healthBarBgHeight,
+          { 0.0f, 1.0f, 0.0f }, HudRole::HealthBar },
     };
+    HudRenderer hud;
+    hud.init(shaderProgram, hudQuads);
+
+    // The render bench draws into its own framebuffer and never swaps, so
+    // neither the compositor nor vsync ends up in its timings
+    OffscreenTarget benchTarget;
+    if (benchRender) {
+        if (!benchTarget.init(static_cast<int>(SCREEN_X_PIXELS), static_cast<int>(SCREEN_Y_PIXELS))) {
+            glfwTerminate();
+            return -1;
+        }
+        benchTarget.bind();
+    }
+    startup.mark("renderer");
+
+    // Follow every file (or map them when replaying archived logs), or the
+    // build's own pipes, on a reader thread; the loop below only pops lines
+    // that are already in memory. A recorded session brings its own lines
+    // and lanes, and the synthetic render bench has one lane that stays
+    // empty.
+    BuildProcess build;
+    IngestThread ingest;
+    CompressedLogList compressedLogs;
+    TraceReader replay;
+    ReplaySource noLines;
+    if (replaying) {
+        if (!replay.open(replayPath)) {
+            glfwTerminate();
+            return -1;
+        }
+        laneConfigs = replay.sourceLanes();
+    } else if (synthetic) {
+        laneConfigs = { defaultSourceLane(0) };
+        laneConfigs[0].source = &noLines;
+    } else {
+        std::vector<std::unique_ptr<LineSource>> sources;
+        bool dropWhenFull = false;
+        if (!buildCommand.empty()) {
+            if (!build.start(buildCommand, buildTimeout)) {
+                glfwTerminate();
+                return -1;
+            }
+            laneConfigs = { defaultSourceLane(0), defaultSourceLane(1) };
+            laneConfigs[0].name = "stderr";
+            laneConfigs[1].name = "stdout";
+            sources.push_back(build.takeStderr());
+            sources.push_back(build.takeStdout());
+            // A full pipe would stall the build, so lines the game can't keep
+            // up with are dropped instead
+            dropWhenFull = true;
+        } else {
+            for (size_t i = 0; i < files.size(); i++) {
+                sources.push_back(openLineSource(files[i], useMmap, compressedLogs));
+                laneConfigs[i].name = files[i].substr(files[i].rfind('/') + 1);
+            }
+        }
+
+        for (size_t i = 0; i < sources.size(); i++) {
+            laneConfigs[i].source = &ingest.addLane(std::move(sources[i]), DEFAULT_INGEST_RING_LINES, dropWhenFull);
+        }
+        ingest.start();
+    }
 
-    // Setup health bar background VAO and VBO
-    unsigned int healthBgVAO, healthBgVBO, healthBgEBO;
-    glGenVertexArrays(1, &healthBgVAO);
-    glGenBuffers(1, &healthBgVBO);
-    glGenBuffers(1, &healthBgEBO);
-
-    glBindVertexArray(healthBgVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, healthBgVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(healthBarBgVertices), healthBarBgVertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, healthBgEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // Define vertices for health bar foreground (dynamic)
-    unsigned int healthFgVAO, healthFgVBO, healthFgEBO;
-    glGenVertexArrays(1, &healthFgVAO);
-    glGenBuffers(1, &healthFgVBO);
-    glGenBuffers(1, &healthFgEBO);
-
-    glBindVertexArray(healthFgVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, healthFgVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 8, nullptr, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, healthFgEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glBindVertexArray(0);
-
-    // Get uniform locations
-    int colorLoc = glGetUniformLocation(shaderProgram, "color");
-    int offsetLoc = glGetUniformLocation(shaderProgram, "offset");
-
-    // Load text lines from both files
-    std::vector<std::string> file1Lines = readAllLines(redTextFile);
-    std::vector<std::string> file2Lines = readAllLines(greenTextFile);
-    int file1Index = 0;
-    int file2Index = 0;
-
-    // Player position, health, and timing
-    float playerX = 0.0f;
-    float playerY = -0.7f;
-    float playerHealth = 100.0f;
-    const float maxHealth = 100.0f;
-    bool isGameOver = false;
-    float lastFrame = 0.0f;
-    float textSpawnTimer = 0.0f;
-    const float textSpawnInterval = 0.5f;
-    float fileReloadTimer = 0.0f;
-    const float fileReloadInterval = 10.0f;
-    float damageTimer = 0.0f;
-    const float damageInterval = 0.5f;  // Take damage every 0.5 seconds while colliding
-    const float damageAmount = 1.0f;
-    bool useFirstFile = true;
+    // Growing logs and builds are live: keep up with them rather than
+    // replaying every line
+    SpawnConfig spawnConfig;
+    bool archived = useMmap || (!files.empty() && compressedLogs.size() == files.size());
+    spawnConfig.realTime = replaying ? replay.settings().realTime : !archived;
+
+    std::vector<ClassifierPattern> patterns;
+    if (classifyPath.empty()) {
+        patterns = defaultClassifierPatterns();
+    } else if (!loadClassifierPatterns(classifyPath, patterns)) {
+        glfwTerminate();
+        return -1;
+    }
+    // A replay merges repeats as its recording did
+    if (replaying && !replay.applySettings(hashClassifierPatterns(patterns), dedup)) {
+        glfwTerminate();
+        return -1;
+    }
+
+    // Everything the simulation takes in can be written out for replay
+    TraceWriter trace;
+    std::vector<std::unique_ptr<RecordingSource>> recorders;
+    if (!recordPath.empty()) {
+        TraceSettings traceSettings;
+        traceSettings.realTime = spawnConfig.realTime;
+        traceSettings.dedup = dedup;
+        traceSettings.classifierHash = hashClassifierPatterns(patterns);
+        if (!trace.open(recordPath, traceSettings, laneConfigs)) {
+            glfwTerminate();
+            return -1;
+        }
+        for (size_t i = 0; i < laneConfigs.size(); i++) {
+            recorders.push_back(std::make_unique<RecordingSource>(*laneConfigs[i].source, trace, i));
+            laneConfigs[i].source = recorders.back().get();
+        }
+    }
+
+    Simulation simulation(laneConfigs);
+    simulation.setSpawnConfig(spawnConfig);
+    simulation.setDedupConfig(dedup);
+    if (!classifyPath.empty()) {
+        simulation.setClassifier(LineClassifier(patterns));
+    }
+    std::unique_ptr<SyntheticWorkload> benchWorkload;
+    if (synthetic) {
+        benchWorkload = std::make_unique<SyntheticWorkload>(benchTexts);
+    }
+    const WorldState& world = synthetic ? benchWorkload->state() : simulation.state();
+    startup.mark("sources");
+
+    // Phase timing, off unless --profile was given
+    FrameProfiler profiler;
+    if (!profilePath.empty() && !profiler.open(profilePath)) {
+        glfwTerminate();
+        return -1;
+    }
+    simulation.setProfiler(&profiler);
+    GpuTimer gpuTimer;
+    gpuTimer.init(profiler);
+    const double summaryInterval = 5.0;
+    double lastSummary = 0.0;
+    double lastFrame = glfwGetTime();
+    double lastTitleUpdate = 0.0;
+    FixedTimestep timestep;
+    // Where the player was before the latest step, to draw it in between
+    float previousPlayerX = world.playerX;
+
+    // Debug check that the loop stops allocating once warmed up
+    const double allocationWarmup = 5.0;
+    bool allocationsCounting = false;
+    uint64_t allocationsAtWarmup = 0;
+    uint64_t framesCounted = 0;
+    uint64_t framesDrawn = 0;
+
+    // A replay is measured in full, with its first frames as the warm-up
+    RenderBenchRecorder benchRecorder(replaying ? replay.frameTotal() : benchFrames,
+                                      replaying ? 0 : BENCH_WARMUP_FRAMES);
+
+    double replayStart = glfwGetTime();
 
     // Render loop
     while (!glfwWindowShouldClose(window)) {
-        // Calculate delta time
-        float currentFrame = glfwGetTime();
-        float deltaTime = currentFrame - lastFrame;
+        if (synthetic && benchRecorder.finished()) break;
+        profiler.beginFrame();
+        if (benchRender) benchRecorder.beginFrame();
+        // Results of passes from earlier frames that the GPU has finished
+        gpuTimer.collect();
+
+        // The game steps at a fixed rate: as many steps as the real time
+        // since the last frame covers, the rest carried over
+        double currentFrame = glfwGetTime();
+        SimInput input;
+        processInput(window, input);
+        input.deltaTime = timestep.step();
+        unsigned int steps = timestep.advance(currentFrame - lastFrame);
         lastFrame = currentFrame;
+        float alpha = timestep.alpha();
+        // A replay takes one recorded step (timestep and keys) per frame
+        // instead, and ends with the recording. The synthetic bench steps
+        // once a frame too. Both draw each step as it is.
+        if (replaying || synthetic) {
+            steps = 1;
+            alpha = 1.0f;
+        }
 
-        processInput(window, playerX, deltaTime);
-
-        // Reload text files every 10 seconds
-        fileReloadTimer += deltaTime;
-        if (fileReloadTimer >= fileReloadInterval) {
-            fileReloadTimer = 0.0f;
-            file1Lines = readAllLines(redTextFile);
-            file2Lines = readAllLines(greenTextFile);
-            // Clamp indices to prevent out-of-bounds if files got shorter
-            if (file1Index >= file1Lines.size() && !file1Lines.empty()) {
-                file1Index = file1Lines.size();
-            }
-            if (file2Index >= file2Lines.size() && !file2Lines.empty()) {
-                file2Index = file2Lines.size();
+        // Updated after the shell exits too: the timeout still applies to
+        // any jobs it left running
+        bool buildWasRunning = build.running();
+        build.update();
+        if (buildWasRunning && !build.running()) {
+            int status = build.exitStatus();
+            if (WIFSIGNALED(status)) {
+                std::cout << "Build stopped by signal " << WTERMSIG(status) << " after " << build.elapsedSeconds()
+                          << " s" << std::endl;
+            } else {
+                std::cout << "Build finished with status " << WEXITSTATUS(status) << " after "
+                          << build.elapsedSeconds() << " s" << std::endl;
             }
         }
 
-        // Spawn new falling text every textSpawnInterval seconds, alternating between files
-        if (!isGameOver) {
-            textSpawnTimer += deltaTime;
-            if (textSpawnTimer >= textSpawnInterval) {
-                textSpawnTimer = 0.0f;
-
-                std::string nextLine;
-                if (useFirstFile) {
-                    nextLine = getNextLine(file1Lines, file1Index);
+        bool replayEnded = false;
+        {
+            ScopedPhase phase(&profiler, "simulate");
+            for (unsigned int step = 0; step < steps; step++) {
+                if (replaying && !replay.nextFrame(input)) {
+                    replayEnded = true;
+                    break;
+                }
+                trace.frame(input);
+                previousPlayerX = world.playerX;
+                if (synthetic) {
+                    benchWorkload->step(input.deltaTime);
                 } else {
-                    nextLine = getNextLine(file2Lines, file2Index);
+                    simulation.step(input);
                 }
+            }
+        }
+        if (replayEnded) {
+            break;
+        }
 
-            if (!nextLine.empty()) {
-                FallingText newText;
-                newText.text = nextLine;
-                newText.x = 150.0f;
-                newText.y = 850.0f;
-                newText.speed = 50.0f;
-
-                // Red for first file, green for second file
-                if (useFirstFile) {
-                    newText.r = 1.0f;
-                    newText.g = 0.0f;
-                    newText.b = 0.0f;
+        if (allocationsCounting) {
+            framesCounted++;
+        } else if (currentFrame >= allocationWarmup) {
+            allocationsCounting = true;
+            allocationsAtWarmup = heapAllocationCount();
+        }
+
+        {
+            ScopedPhase phase(&profiler, "hud");
+            gpuTimer.begin("gpu_hud");
+
+            // Clear screen
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            // Player turns red when colliding; health bar is green > 66%,
+            // yellow > 33%, red below
+            Color playerColor = world.isColliding ? Color{ 1.0f, 0.0f, 0.0f } : Color{ 0.5f, 0.5f, 0.5f };
+            float healthPercent = world.playerHealth / world.maxHealth;
+            Color healthColor = { 1.0f, 0.0f, 0.0f };
+            if (healthPercent > 0.66f) {
+                healthColor = { 0.0f, 1.0f, 0.0f };
+            } else if (healthPercent > 0.33f) {
+                healthColor = { 1.0f, 1.0f, 0.0f };
+            }
+            float playerX = previousPlayerX + (world.playerX - previousPlayerX) * alpha;
+            hud.draw(playerX, world.playerY, playerColor, healthPercent, healthColor);
+
+            gpuTimer.end();
+        }
+
+        // Draw falling texts with their respective colors
+        {
+            ScopedPhase phase(&profiler, "text_vertices");
+            const TextStore& texts = world.fallingTexts;
+            // Texts fall straight down at a constant speed, so where one was
+            // a step ago is its speed times a step above where it is now
+            float stepsBehind = (1.0f - alpha) * timestep.step();
+            for (size_t i = 0; i < texts.size(); i++) {
+                const Color& color = world.palette[texts.palette[i]];
+                float y = texts.y[i] + texts.speed[i] * stepsBehind;
+                // Laid out at spawn, cut to the window; a text that got no
+                // layout is drawn as it stands, up to the right edge
+                const LayoutGlyph* glyphs;
+                size_t glyphCount;
+                if (texts.layout(i, glyphs, glyphCount)) {
+                    textBatch.addLayout(glyphs, glyphCount, texts.x[i], y, 0.5f, color.r, color.g, color.b);
                 } else {
-                    newText.r = 0.0f;
-                    newText.g = 1.0f;
-                    newText.b = 0.0f;
+                    textBatch.addText(texts.text(i), texts.x[i], y, 0.5f, color.r, color.g, color.b, SCREEN_X_PIXELS);
                 }
+                // A merged repeat's counter ends its box
+                if (texts.repeats(i) > 1) {
+                    char counter[24];
+                    std::string_view count(counter, formatRepeatCount(texts.repeats(i), counter, sizeof(counter)));
+                    float countX = texts.x[i] + texts.width[i] - getTextWidth(count, 0.5f);
+                    textBatch.addText(count, countX, y, 0.5f, color.r, color.g, color.b);
+                }
+            }
 
-                fallingTexts.push_back(newText);
+            // Draw "Git Gud" message if game over
+            if (world.isGameOver) {
+                textBatch.addText("Git Gud", 450.0f, SCREEN_X_PIXELS/2.0f, 1.5f, 1.0f, 0.0f, 0.0f);
             }
 
-            useFirstFile = !useFirstFile;
+            // Let the player know when the log is outrunning the game
+            const SpawnStats& spawn = simulation.spawnStats();
+            if (spawnConfig.realTime && spawn.linesIn > spawn.linesSpawned) {
+                char status[128];
+                int length = std::snprintf(status, sizeof(status), "backlog %zu  lag %.1f s  skipped %llu",
+                                           spawn.backlog, spawn.lagSeconds,
+                                           static_cast<unsigned long long>(spawn.droppedOverflow + spawn.droppedStale));
+                textBatch.addText(std::string_view(status, std::min<size_t>(length, sizeof(status) - 1)),
+                                  20.0f, 1160.0f, 0.4f, 0.6f, 0.6f, 0.6f);
             }
         }
 
-        // Update falling texts
-        for (auto& text : fallingTexts) {
-            text.y -= text.speed * deltaTime;
+        // Submit all text for this frame in a single draw call
+        {
+            ScopedPhase phase(&profiler, "text_submit");
+            gpuTimer.begin("gpu_text");
+            textBatch.flush();
+            gpuTimer.end();
         }
 
-        // Remove texts that have fallen off screen
-        fallingTexts.erase(
-            std::remove_if(fallingTexts.begin(), fallingTexts.end(),
-                [](const FallingText& text) { return text.y < 0.0f; }),
-            fallingTexts.end()
-        );
-
-        // Check for collisions with player
-        bool isColliding = false;
-        bool isCollidingWithRed = false;
-        for (const auto& text : fallingTexts) {
-            if (checkCollision(playerX, playerY, 0.05f, text.x, text.y, text.text, 0.5f)) {
-                isColliding = true;
-                // Check if this is red text (from first file)
-                if (text.r == 1.0f && text.g == 0.0f && text.b == 0.0f) {
-                    isCollidingWithRed = true;
+        if (benchRender) {
+            RenderStats rendered = hud.stats();
+            rendered += textBatch.stats();
+            benchRecorder.endFrame(rendered);
+            glfwPollEvents();
+        } else {
+            ScopedPhase phase(&profiler, "swap");
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        profiler.endFrame();
+        if (framesDrawn++ == 0) {
+            startup.mark("first frame");
+            startup.print();
+        }
+
+        // Nothing falling and nothing held: drop to the idle rate, waiting
+        // on events so a key press or a window event still wakes it at once
+        if (!offscreen) {
+            bool idle = world.fallingTexts.empty() && !input.moveLeft && !input.moveRight;
+            double wait = pacer.frameDone(idle);
+            if (wait > 0.0) {
+                ScopedPhase phase(&profiler, "pace");
+                if (idle) {
+                    glfwWaitEventsTimeout(wait);
+                } else {
+                    pacer.sleepUntilDeadline();
                 }
             }
         }
 
-        // Apply damage from red text collisions
-        if (isCollidingWithRed && !isGameOver) {
-            damageTimer += deltaTime;
-            if (damageTimer >= damageInterval) {
-                damageTimer = 0.0f;
-                playerHealth -= damageAmount;
-                if (playerHealth <= 0.0f) {
-                    playerHealth = 0.0f;
-                    isGameOver = true;
+        // Ingest stats in the title bar, refreshed once a second: each lane
+        // while they fit, totals over all of them once they don't
+        if (ingest.laneCount() > 0 && currentFrame - lastTitleUpdate >= 1.0) {
+            lastTitleUpdate = currentFrame;
+            char title[512];
+            int length = std::snprintf(title, sizeof(title), "%s -", windowTitle);
+            IngestStats total = {};
+            for (size_t i = 0; i < ingest.laneCount(); i++) {
+                IngestStats lane = ingest.lane(i).stats();
+                if (ingest.laneCount() <= 4) {
+                    length += std::snprintf(title + length, sizeof(title) - length,
+                                            "%s %s %.0f lines/s, queue %zu/%zu, dropped %llu", i == 0 ? "" : " |",
+                                            laneConfigs[i].name.c_str(), lane.linesPerSecond, lane.queueDepth,
+                                            lane.queueCapacity, static_cast<unsigned long long>(lane.linesDropped));
+                    length = std::min<int>(length, sizeof(title) - 1);
                 }
+                total.linesPerSecond += lane.linesPerSecond;
+                total.queueDepth += lane.queueDepth;
+                total.queueCapacity += lane.queueCapacity;
+                total.linesDropped += lane.linesDropped;
             }
-        } else {
-            damageTimer = 0.0f;  // Reset timer when not colliding
+            if (ingest.laneCount() > 4) {
+                std::snprintf(title + length, sizeof(title) - length,
+                              " %zu lanes %.0f lines/s, queued %zu/%zu, dropped %llu", ingest.laneCount(),
+                              total.linesPerSecond, total.queueDepth, total.queueCapacity,
+                              static_cast<unsigned long long>(total.linesDropped));
+            }
+            glfwSetWindowTitle(window, title);
         }
 
-        // Clear screen
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        glUseProgram(shaderProgram);
-
-        // Draw outer square (white border) - no offset
-        glUniform2f(offsetLoc, 0.0f, 0.0f);
-        glUniform3f(colorLoc, 1.0f, 1.0f, 1.0f);
-        glBindVertexArray(outerVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        // Draw inner square (black center) - no offset
-        glUniform2f(offsetLoc, 0.0f, 0.0f);
-        glUniform3f(colorLoc, 0.0f, 0.0f, 0.0f);
-        glBindVertexArray(innerVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        // Draw player square (changes color based on collision)
-        glUniform2f(offsetLoc, playerX, playerY);
-        if (isColliding) {
-            glUniform3f(colorLoc, 1.0f, 0.0f, 0.0f); // Red when colliding
-        } else {
-            glUniform3f(colorLoc, 0.5f, 0.5f, 0.5f); // Grey normally
+        if (profiler.enabled() && currentFrame - lastSummary >= summaryInterval) {
+            lastSummary = currentFrame;
+            profiler.printSummary(std::cout);
         }
-        glBindVertexArray(playerVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        // Draw health bar
-        // Background (dark grey)
-        glUniform2f(offsetLoc, 0.0f, 0.0f);
-        glUniform3f(colorLoc, 0.2f, 0.2f, 0.2f);
-        glBindVertexArray(healthBgVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        // Foreground (color based on health level)
-        float healthPercent = playerHealth / maxHealth;
-        float healthFgWidth = healthBarBgWidth * healthPercent;
-        float healthFgVertices[] = {
-            -healthBarBgWidth, healthBarBgY - healthBarBgHeight,  // bottom left
-            -healthBarBgWidth + (healthFgWidth * 2.0f), healthBarBgY - healthBarBgHeight,  // bottom right
-            -healthBarBgWidth + (healthFgWidth * 2.0f), healthBarBgY + healthBarBgHeight,  // top right
-            -healthBarBgWidth, healthBarBgY + healthBarBgHeight   // top left
-        };
-
-        glBindBuffer(GL_ARRAY_BUFFER, healthFgVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(healthFgVertices), healthFgVertices);
-
-        glUniform2f(offsetLoc, 0.0f, 0.0f);
-        // Color based on health level: green > 66%, yellow > 33%, red <= 33%
-        if (healthPercent > 0.66f) {
-            glUniform3f(colorLoc, 0.0f, 1.0f, 0.0f); // Green
-        } else if (healthPercent > 0.33f) {
-            glUniform3f(colorLoc, 1.0f, 1.0f, 0.0f); // Yellow
-        } else {
-            glUniform3f(colorLoc, 1.0f, 0.0f, 0.0f); // Red
-        }
-        glBindVertexArray(healthFgVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    }
 
-        // Draw falling texts with their respective colors
-        for (const auto& text : fallingTexts) {
-            renderText(textShaderProgram, textVAO, textVBO, text.text,
-                      text.x, text.y, 0.5f, text.r, text.g, text.b);
+    if (profiler.enabled()) {
+        profiler.printSummary(std::cout);
+        if (gpuTimer.droppedSamples() > 0) {
+            std::cout << "GPU timer samples dropped: " << gpuTimer.droppedSamples() << std::endl;
         }
+        // Should stay at zero: the CPU writing text never waits on the GPU
+        const StreamBuffer& stream = textBatch.stream();
+        std::cout << "Text stream (" << (stream.persistent() ? "persistent" : "mapped range")
+                  << "): fence waits " << stream.fenceWaits() << ", orphans " << stream.orphans() << std::endl;
+        const GlyphCacheStats& glyphs = glyphCache.stats();
+        std::cout << "Glyph cache: " << glyphs.glyphsLoaded << " glyphs, " << glyphs.glyphsRasterized
+                  << " rasterized, " << glyphCache.pageCount() << " pages (" << glyphCache.pageBytes() / 1024
+                  << " KB), " << glyphs.pagesEvicted << " evicted, " << glyphs.glyphsDropped << " dropped" << std::endl;
+        profiler.close();
+    }
+
+    if (allocationCountingEnabled() && allocationsCounting) {
+        std::cout << "Heap allocations after warm-up: " << heapAllocationCount() - allocationsAtWarmup
+                  << " over " << framesCounted << " frames" << std::endl;
+    }
 
-        // Draw "Git Gud" message if game over
-        if (isGameOver) {
-            renderText(textShaderProgram, textVAO, textVBO, "Git Gud",
-                      450.0f, SCREEN_X_PIXELS/2.0f, 1.5f, 1.0f, 0.0f, 0.0f);
+    if (!offscreen) {
+        pacer.printSummary(std::cout);
+    }
+    for (const auto& [path, log] : compressedLogs) {
+        printCompressedLogStats(std::cout, path, log->stats());
+    }
+    if (replaying) {
+        double replaySeconds = glfwGetTime() - replayStart;
+        std::cout << "Replayed " << replay.frames() << " frames, " << replay.lines() << " lines in "
+                  << replaySeconds << " s (" << replay.frames() / replaySeconds << " frames/s)" << std::endl;
+        std::cout << "Spawned texts: " << world.spawnedTexts << ", final health: " << world.playerHealth
+                  << (world.isGameOver ? " (game over)" : "") << std::endl;
+    }
+    if (benchRender) {
+        benchRecorder.print(std::cout, replaying ? replayPath.c_str() : "synthetic");
+        if (synthetic) {
+            std::cout << "  " << world.fallingTexts.size() << " texts on screen, " << glyphCache.pageCount()
+                      << " glyph pages" << std::endl;
         }
+    }
+    if (trace.isOpen()) {
+        trace.close();
+        std::cout << "Recorded " << trace.frames() << " frames, " << trace.lines() << " lines to "
+                  << recordPath << std::endl;
+    }
+
+    if (glyphCache.changed()) {
+        glyphCache.save(glyphCachePath);
+    }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
-    }
-
-    // Cleanup
-    glDeleteVertexArrays(1, &outerVAO);
-    glDeleteVertexArrays(1, &innerVAO);
-    glDeleteVertexArrays(1, &playerVAO);
-    glDeleteVertexArrays(1, &healthBgVAO);
-    glDeleteVertexArrays(1, &healthFgVAO);
-    glDeleteBuffers(1, &outerVBO);
-    glDeleteBuffers(1, &innerVBO);
-    glDeleteBuffers(1, &playerVBO);
-    glDeleteBuffers(1, &healthBgVBO);
-    glDeleteBuffers(1, &healthFgVBO);
-    glDeleteBuffers(1, &outerEBO);
-    glDeleteBuffers(1, &innerEBO);
-    glDeleteBuffers(1, &playerEBO);
-    glDeleteBuffers(1, &healthBgEBO);
-    glDeleteBuffers(1, &healthFgEBO);
+    // Cleanup: take the build (and every job it started) down with the game
+    build.stop();
+    ingest.stop();
+    benchTarget.destroy();
+    hud.destroy();
     glDeleteProgram(shaderProgram);
+    textBatch.destroy();
+    glDeleteProgram(textShaderProgram);
+    gpuTimer.destroy();
 
     glfwTerminate();
     return 0;
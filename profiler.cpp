@@ -0,0 +1,144 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+static double steadyNowUs() {
+    using Clock = std::chrono::steady_clock;
+    return std::chrono::duration<double, std::micro>(Clock::now().time_since_epoch()).count();
+}
+
+RollingSamples::RollingSamples(size_t windowSize) : values(windowSize) {
+}
+
+void RollingSamples::add(double value) {
+    values[next] = value;
+    next = (next + 1) % values.size();
+    if (filled < values.size()) filled++;
+}
+
+double RollingSamples::percentile(double p, std::vector<double>& scratch) const {
+    if (filled == 0) return 0.0;
+    scratch.assign(values.begin(), values.begin() + filled);
+    size_t rank = static_cast<size_t>(p / 100.0 * (filled - 1) + 0.5);
+    std::nth_element(scratch.begin(), scratch.begin() + rank, scratch.end());
+    return scratch[rank];
+}
+
+FrameProfiler::FrameProfiler() : originUs(steadyNowUs()) {
+    // Everything the frame loop touches is sized here so profiling doesn't
+    // add allocations of its own
+    phases.reserve(PROFILER_MAX_PHASES);
+    scratch.reserve(PROFILER_WINDOW_FRAMES);
+}
+
+FrameProfiler::~FrameProfiler() {
+    close();
+}
+
+bool FrameProfiler::open(const std::string& path) {
+    close();
+    trace = std::fopen(path.c_str(), "w");
+    if (!trace) {
+        std::cerr << "ERROR::PROFILER: Could not create trace file " << path << std::endl;
+        return false;
+    }
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", trace);
+    firstEvent = true;
+    active = true;
+
+    // Name the two rows so the viewer doesn't just show thread ids
+    std::fprintf(trace, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"CPU\"}},\n"
+                        "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU\"}}",
+                 CPU_TRACK, GPU_TRACK);
+    firstEvent = false;
+    return true;
+}
+
+void FrameProfiler::close() {
+    if (!trace) return;
+    std::fputs("\n]}\n", trace);
+    std::fclose(trace);
+    trace = nullptr;
+}
+
+double FrameProfiler::nowUs() const {
+    return steadyNowUs() - originUs;
+}
+
+void FrameProfiler::beginFrame() {
+    if (!active) return;
+    frameStartUs = nowUs();
+    depth = 0;
+}
+
+void FrameProfiler::endFrame() {
+    if (!active) return;
+    double duration = nowUs() - frameStartUs;
+    frameTimes.add(duration / 1000.0);
+    writeEvent("frame", frameStartUs, duration, CPU_TRACK);
+    frames++;
+}
+
+void FrameProfiler::beginPhase(const char* name) {
+    if (depth == PROFILER_MAX_DEPTH) {
+        depth++;  // too deep to record, but keep begin/end balanced
+        return;
+    }
+    stack[depth++] = { name, nowUs() };
+}
+
+void FrameProfiler::endPhase() {
+    if (depth == 0) return;
+    if (--depth >= PROFILER_MAX_DEPTH) return;
+    const OpenPhase& open = stack[depth];
+    recordPhase(open.name, open.startUs, nowUs() - open.startUs, CPU_TRACK);
+}
+
+void FrameProfiler::recordPhase(const char* name, double startUs, double durationUs, int track) {
+    if (!active) return;
+    phase(name).samples.add(durationUs / 1000.0);
+    writeEvent(name, startUs, durationUs, track);
+}
+
+FrameProfiler::Phase& FrameProfiler::phase(const char* name) {
+    // A handful of phases, almost always hit on the first few compares
+    for (auto& p : phases) {
+        if (p.name == name || std::strcmp(p.name, name) == 0) return p;
+    }
+    if (phases.size() == PROFILER_MAX_PHASES) return phases.back();
+    phases.push_back({ name, RollingSamples() });
+    return phases.back();
+}
+
+void FrameProfiler::writeEvent(const char* name, double startUs, double durationUs, int track) {
+    if (!trace) return;
+    std::fprintf(trace, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                 firstEvent ? "" : ",\n", name, track, startUs, durationUs);
+    firstEvent = false;
+}
+
+void FrameProfiler::printSummary(std::ostream& out) {
+    if (!active || frameTimes.count() == 0) return;
+
+    auto row = [&](const char* name, const RollingSamples& samples) {
+        out << "  " << std::left << std::setw(14) << name << std::right
+            << std::setw(9) << samples.percentile(50.0, scratch)
+            << std::setw(9) << samples.percentile(95.0, scratch)
+            << std::setw(9) << samples.percentile(99.0, scratch) << std::endl;
+    };
+
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(3);
+    out << "Frame times (ms) over the last " << frameTimes.count() << " of " << frames << " frames" << std::endl;
+    out << "  " << std::left << std::setw(14) << "phase" << std::right
+        << std::setw(9) << "p50" << std::setw(9) << "p95" << std::setw(9) << "p99" << std::endl;
+    row("frame", frameTimes);
+    for (const auto& p : phases) {
+        row(p.name, p.samples);
+    }
+    out.flags(flags);
+}
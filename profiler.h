@@ -0,0 +1,118 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#define PROFILER_MAX_PHASES 32
+#define PROFILER_MAX_DEPTH 8
+#define PROFILER_WINDOW_FRAMES 600
+
+// Last N samples of one timing, for rolling percentiles
+class RollingSamples {
+public:
+    explicit RollingSamples(size_t windowSize = PROFILER_WINDOW_FRAMES);
+
+    void add(double value);
+    size_t count() const { return filled; }
+
+    // p in [0, 100]; sorts a copy into scratch, which must hold count() values
+    double percentile(double p, std::vector<double>& scratch) const;
+
+private:
+    std::vector<double> values;
+    size_t next = 0;
+    size_t filled = 0;
+};
+
+// Per-frame phase timings. Phases are timed with steady_clock on the CPU, or
+// reported after the fact for GPU passes. Each finished phase goes to an
+// optional Chrome trace_event file (load it in chrome://tracing or Perfetto)
+// and into a rolling window from which p50/p95/p99 are summarised.
+//
+// Nothing is recorded until open() or enableSummary() is called, so the
+// timers can stay in the loop at the cost of one branch each.
+class FrameProfiler {
+public:
+    FrameProfiler();
+    ~FrameProfiler();
+
+    // Starts writing trace events to path. Returns false if it can't be created.
+    bool open(const std::string& path);
+    // Collects percentiles without writing a trace
+    void enableSummary() { active = true; }
+    void close();
+
+    bool enabled() const { return active; }
+
+    // Microseconds since the profiler was constructed
+    double nowUs() const;
+
+    void beginFrame();
+    void endFrame();
+
+    // name must outlive the profiler (string literals)
+    void beginPhase(const char* name);
+    void endPhase();
+
+    // A phase timed elsewhere, e.g. a GPU query read back a few frames later.
+    // startUs is on this profiler's clock.
+    void recordPhase(const char* name, double startUs, double durationUs, int track);
+
+    // Prints p50/p95/p99 for the frame and every phase seen so far
+    void printSummary(std::ostream& out);
+
+    // Trace rows: CPU phases and frames, and GPU passes
+    static const int CPU_TRACK = 1;
+    static const int GPU_TRACK = 2;
+
+private:
+    struct Phase {
+        const char* name;
+        RollingSamples samples;
+    };
+    struct OpenPhase {
+        const char* name;
+        double startUs;
+    };
+
+    Phase& phase(const char* name);
+    void writeEvent(const char* name, double startUs, double durationUs, int track);
+
+    bool active = false;
+    std::FILE* trace = nullptr;
+    bool firstEvent = true;
+    double originUs;
+
+    double frameStartUs = 0.0;
+    uint64_t frames = 0;
+    RollingSamples frameTimes;
+    std::vector<Phase> phases;
+    OpenPhase stack[PROFILER_MAX_DEPTH];
+    size_t depth = 0;
+    std::vector<double> scratch;
+};
+
+// Times the enclosing scope as a phase. A null or disabled profiler costs
+// one branch.
+class ScopedPhase {
+public:
+    ScopedPhase(FrameProfiler* profiler, const char* name)
+        : profiler(profiler && profiler->enabled() ? profiler : nullptr) {
+        if (this->profiler) this->profiler->beginPhase(name);
+    }
+    ~ScopedPhase() {
+        if (profiler) profiler->endPhase();
+    }
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+
+private:
+    FrameProfiler* profiler;
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include "render_bench.h"
+
+#include "font.h"
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+
+bool OffscreenTarget::init(int targetWidth, int targetHeight) {
+    width = targetWidth;
+    height = targetHeight;
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "ERROR::RENDER_BENCH: Offscreen framebuffer incomplete (0x" << std::hex << status
+                  << std::dec << ")" << std::endl;
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+void OffscreenTarget::destroy() {
+    if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+    if (colorBuffer) glDeleteRenderbuffers(1, &colorBuffer);
+    framebuffer = colorBuffer = 0;
+}
+
+void OffscreenTarget::bind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+}
+
+// The kinds of line a build prints, with the category the classifier would
+// give each. Curly quotes are what gcc prints in a UTF-8 locale, so the
+// glyph cache sees more than ASCII.
+struct LineTemplate {
+    const char* format;
+    TextCategory category;
+};
+
+static const LineTemplate lineTemplates[] = {
+    { "src/module%u/file%u.cpp:%u:%u: error: \xE2\x80\x98value%u\xE2\x80\x99 was not declared in this scope", TextCategory::Error },
+    { "src/module%u/file%u.cpp:%u:%u: warning: unused variable \xE2\x80\x98tmp%u\xE2\x80\x99 [-Wunused-variable]", TextCategory::Warning },
+    { "src/module%u/file%u.h:%u:%u: note: candidate expects %u arguments", TextCategory::Note },
+    { "[ %u%%] Building CXX object module%u/CMakeFiles/file%u.dir/file%u.cpp.o (%u)", TextCategory::Progress },
+    { "make[%u]: Entering directory '/build/module%u/file%u' (%u, %u)", TextCategory::Other },
+};
+
+static const float benchTextScale = 0.5f;
+// One speed for every text, as in the game: texts then leave in the order
+// they were spawned, which is the order the text arenas reclaim space in
+static const float benchTextSpeed = 60.0f;
+
+SyntheticWorkload::SyntheticWorkload(size_t textCount, uint32_t seed)
+    : line(MAX_TEXT_BYTES), layoutGlyphs(MAX_TEXT_BYTES + 1), random(seed ? seed : 1) {
+    textCount = std::min(textCount, world.fallingTexts.capacity());
+    for (size_t i = 0; i < textCount; i++) {
+        // Spread over the screen from the start rather than arriving in a wave
+        spawnLine(SCREEN_Y_PIXELS * static_cast<float>(i) / static_cast<float>(std::max<size_t>(textCount, 1)));
+    }
+}
+
+void SyntheticWorkload::spawnLine(float y) {
+    // xorshift32: cheap, and the same sequence on every platform
+    auto next = [this]() {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        return random;
+    };
+    const LineTemplate& pick = lineTemplates[next() % (sizeof(lineTemplates) / sizeof(lineTemplates[0]))];
+    int length = std::snprintf(line.data(), line.size(), pick.format, next() % 100, next() % 1000,
+                               next() % 2000, next() % 80, next() % 100);
+    std::string_view text(line.data(), std::min<size_t>(std::max(length, 0), line.size() - 1));
+
+    float x = static_cast<float>(next() % 1000) - 0.25f * getTextWidth(text, benchTextScale);
+    // Laid out like the game's texts, so both ends get clipped
+    float width;
+    size_t glyphCount = layoutText(text, x, benchTextScale, 0.0f, SCREEN_X_PIXELS, layoutGlyphs.data(),
+                                   layoutGlyphs.size(), width);
+    world.fallingTexts.spawn(text, pick.category, static_cast<uint8_t>(pick.category), x, y, benchTextSpeed, width,
+                             getTextHeight(benchTextScale), layoutGlyphs.data(), glyphCount);
+    world.spawnedTexts++;
+}
+
+void SyntheticWorkload::step(float deltaTime) {
+    TextStore& texts = world.fallingTexts;
+    texts.integrate(deltaTime);
+    size_t gone = texts.removeBelow(-getTextHeight(benchTextScale));
+    for (size_t i = 0; i < gone; i++) {
+        spawnLine(SCREEN_Y_PIXELS);
+    }
+
+    // Keep the player and health bar moving so their uniforms change
+    sweep += deltaTime;
+    world.playerX = 0.7f * std::sin(sweep);
+    world.playerHealth = world.maxHealth * (0.5f + 0.5f * std::cos(0.3f * sweep));
+    world.isColliding = std::fmod(sweep, 2.0f) < 0.5f;
+}
+
+RenderBenchRecorder::RenderBenchRecorder(size_t measuredFrames, size_t warmupFrames)
+    : frameTarget(measuredFrames), warmup(warmupFrames), frameTimes(std::max<size_t>(measuredFrames, 1)) {
+    scratch.reserve(std::max<size_t>(measuredFrames, 1));
+}
+
+double RenderBenchRecorder::now() const {
+    using Clock = std::chrono::steady_clock;
+    return std::chrono::duration<double, std::milli>(Clock::now().time_since_epoch()).count();
+}
+
+void RenderBenchRecorder::beginFrame() {
+    frameStart = now();
+}
+
+void RenderBenchRecorder::endFrame(const RenderStats& total) {
+    // Wait for the GPU so a frame's cost isn't carried into the next one
+    glFinish();
+    double elapsed = now() - frameStart;
+
+    RenderStats frame;
+    frame.drawCalls = total.drawCalls - lastTotal.drawCalls;
+    frame.stateChanges = total.stateChanges - lastTotal.stateChanges;
+    frame.bufferUploads = total.bufferUploads - lastTotal.bufferUploads;
+    frame.textureUploads = total.textureUploads - lastTotal.textureUploads;
+    frame.uploadedBytes = total.uploadedBytes - lastTotal.uploadedBytes;
+    lastTotal = total;
+
+    if (frames++ < warmup || finished()) return;
+    frameTimes.add(elapsed);
+    measuredTotal += frame;
+    maxDrawCalls = std::max(maxDrawCalls, frame.drawCalls);
+    maxStateChanges = std::max(maxStateChanges, frame.stateChanges);
+    measured++;
+}
+
+void RenderBenchRecorder::print(std::ostream& out, const char* workload) {
+    if (measured == 0) {
+        out << "Render bench (" << workload << "): no frames measured" << std::endl;
+        return;
+    }
+    double perFrame = 1.0 / static_cast<double>(measured);
+
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(3);
+    out << "Render bench (" << workload << "): " << measured << " frames after " << warmup << " warm-up" << std::endl;
+    out << "  frame ms    p50 " << frameTimes.percentile(50.0, scratch)
+        << "  p95 " << frameTimes.percentile(95.0, scratch)
+        << "  p99 " << frameTimes.percentile(99.0, scratch)
+        << "  max " << frameTimes.percentile(100.0, scratch) << std::endl;
+    out << std::setprecision(2);
+    out << "  per frame   draw calls " << measuredTotal.drawCalls * perFrame << " (max " << maxDrawCalls << ")"
+        << "  state changes " << measuredTotal.stateChanges * perFrame << " (max " << maxStateChanges << ")" << std::endl;
+    out << "  uploads     buffers " << measuredTotal.bufferUploads * perFrame
+        << "  textures " << measuredTotal.textureUploads * perFrame
+        << "  KB " << measuredTotal.uploadedBytes * perFrame / 1024.0 << std::endl;
+    out.flags(flags);
+}
@@ -0,0 +1,86 @@
+#ifndef RENDER_BENCH_H
+#define RENDER_BENCH_H
+
+#include "profiler.h"
+#include "render_stats.h"
+#include "simulation.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#define DEFAULT_BENCH_TEXTS 400
+#define DEFAULT_BENCH_FRAMES 600
+// Frames drawn before timing starts: first glyph rasterization, atlas
+// allocation and driver shader compiles all land here
+#define BENCH_WARMUP_FRAMES 30
+
+// Colour target the size of the window, so a benchmark renders the same
+// pixels whether or not the window is ever shown
+class OffscreenTarget {
+public:
+    bool init(int targetWidth, int targetHeight);
+    void destroy();
+
+    // Directs drawing here until the default framebuffer is bound again
+    void bind();
+
+private:
+    unsigned int framebuffer = 0;
+    unsigned int colorBuffer = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// A screenful of falling compiler output of a chosen size, kept at that
+// size: texts leaving the bottom come back in at the top. Lines are made
+// up from a fixed seed, so every run draws the same frames.
+class SyntheticWorkload {
+public:
+    SyntheticWorkload(size_t textCount, uint32_t seed = 1);
+
+    void step(float deltaTime);
+    const WorldState& state() const { return world; }
+
+private:
+    void spawnLine(float y);
+
+    WorldState world;
+    std::vector<char> line;
+    std::vector<LayoutGlyph> layoutGlyphs;
+    uint32_t random;
+    float sweep = 0.0f;
+};
+
+// Per-frame timings and GL work for a fixed number of measured frames.
+// Each frame is timed on the CPU up to glFinish(), so what the GPU did for
+// it is included; counts are whatever the renderers issued in between.
+class RenderBenchRecorder {
+public:
+    explicit RenderBenchRecorder(size_t measuredFrames, size_t warmupFrames = BENCH_WARMUP_FRAMES);
+
+    void beginFrame();
+    // total is the renderers' running counts, summed
+    void endFrame(const RenderStats& total);
+
+    bool finished() const { return measured == frameTarget; }
+    size_t framesMeasured() const { return measured; }
+
+    void print(std::ostream& out, const char* workload);
+
+private:
+    double now() const;
+
+    size_t frameTarget;
+    size_t warmup;
+    size_t frames = 0;
+    size_t measured = 0;
+    double frameStart = 0.0;
+    RollingSamples frameTimes;
+    std::vector<double> scratch;
+    RenderStats lastTotal;
+    RenderStats measuredTotal;
+    uint64_t maxDrawCalls = 0;
+    uint64_t maxStateChanges = 0;
+};
+
+#endif
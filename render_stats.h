@@ -0,0 +1,27 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <cstdint>
+
+// GL work issued by a renderer, counted as it is issued. State changes are
+// every call that changes bound objects or uniforms (program, texture, VAO
+// and buffer bindings, unbinds included), which is what drivers pay for
+// between draws.
+struct RenderStats {
+    uint64_t drawCalls = 0;
+    uint64_t stateChanges = 0;
+    uint64_t bufferUploads = 0;
+    uint64_t textureUploads = 0;
+    uint64_t uploadedBytes = 0;
+
+    RenderStats& operator+=(const RenderStats& other) {
+        drawCalls += other.drawCalls;
+        stateChanges += other.stateChanges;
+        bufferUploads += other.bufferUploads;
+        textureUploads += other.textureUploads;
+        uploadedBytes += other.uploadedBytes;
+        return *this;
+    }
+};
+
+#endif
@@ -0,0 +1,351 @@
+#include "simulation.h"
+#include "font.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+
+static const float spawnColumns[] = { 150.0f, 450.0f, 750.0f };
+static const float damageInterval = 0.5f;  // Take damage every 0.5 seconds while colliding
+static const float damageAmount = 1.0f;  // per hit from an error; warnings do half
+static const float playerMoveSpeed = 1.0f;
+static const float playerMaxX = 0.7f;
+static const float playerSize = 0.05f;
+static const float textScale = 0.5f;
+
+// Colours for lanes past the first two: none red or yellow, which would
+// read as errors or warnings
+static const Color extraLaneColors[] = {
+    { 0.4f, 0.6f, 1.0f },  // blue
+    { 0.8f, 0.5f, 1.0f },  // violet
+    { 1.0f, 0.6f, 0.8f },  // pink
+    { 0.6f, 1.0f, 0.7f },  // mint
+    { 1.0f, 1.0f, 1.0f },  // white
+    { 0.7f, 0.5f, 0.3f },  // brown
+};
+
+static float categoryDamage(TextCategory category) {
+    switch (category) {
+    case TextCategory::Error: return damageAmount;
+    case TextCategory::Warning: return damageAmount * 0.5f;
+    default: return 0.0f;
+    }
+}
+
+bool checkCollision(float playerX, float playerY, float playerSize,
+                    float textX, float textY, float textWidth, float textHeight) {
+    // Convert player square from normalized coords to pixel coords
+    float playerPixelX = (playerX * SCREEN_Y_PIXELS/2.0f) + SCREEN_Y_PIXELS/2.0f;
+    float playerPixelY = (playerY * SCREEN_Y_PIXELS/2.0f) + SCREEN_Y_PIXELS/2.0f;
+    float playerPixelSize = playerSize * SCREEN_Y_PIXELS/2.0f;
+
+    // Player square bounds in pixel coords
+    float playerLeft = playerPixelX - playerPixelSize;
+    float playerRight = playerPixelX + playerPixelSize;
+    float playerTop = playerPixelY - playerPixelSize;
+    float playerBottom = playerPixelY + playerPixelSize;
+
+    // Text bounds in pixel coords
+    float textLeft = textX;
+    float textRight = textX + textWidth;
+    float textTop = textY;
+    float textBottom = textY + textHeight;
+
+    // AABB collision detection
+    return playerLeft < textRight &&
+           playerRight > textLeft &&
+           playerTop < textBottom &&
+           playerBottom > textTop;
+}
+
+SourceLane defaultSourceLane(size_t index) {
+    SourceLane lane;
+    if (index == 0) {
+        lane.category = TextCategory::Error;
+        lane.color = textCategoryColor(TextCategory::Error);
+    } else if (index == 1) {
+        lane.color = textCategoryColor(TextCategory::Other);
+    } else {
+        lane.color = extraLaneColors[(index - 2) % (sizeof(extraLaneColors) / sizeof(extraLaneColors[0]))];
+    }
+    return lane;
+}
+
+bool parseLaneSpec(const std::string& spec, std::string& path, SourceLane& lane) {
+    size_t comma = spec.find(',');
+    path = spec.substr(0, comma);
+    if (path.empty()) {
+        std::cerr << "Lane \"" << spec << "\" has no path" << std::endl;
+        return false;
+    }
+    while (comma != std::string::npos) {
+        size_t start = comma + 1;
+        comma = spec.find(',', start);
+        std::string option = spec.substr(start, comma == std::string::npos ? comma : comma - start);
+        size_t equals = option.find('=');
+        std::string key = option.substr(0, equals);
+        std::string value = equals == std::string::npos ? std::string() : option.substr(equals + 1);
+
+        char* end = nullptr;
+        bool valid = !value.empty();
+        if (valid && key == "category") {
+            valid = parseTextCategory(value, lane.category);
+        } else if (valid && key == "color") {
+            unsigned long rgb = std::strtoul(value.c_str(), &end, 16);
+            valid = value.size() == 6 && *end == '\0';
+            lane.color = { ((rgb >> 16) & 0xFF) / 255.0f, ((rgb >> 8) & 0xFF) / 255.0f, (rgb & 0xFF) / 255.0f };
+        } else if (valid && key == "weight") {
+            unsigned long weight = std::strtoul(value.c_str(), &end, 10);
+            valid = *end == '\0' && weight >= 1 && weight <= 100;
+            lane.weight = static_cast<uint32_t>(weight);
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            std::cerr << "Bad lane option \"" << option << "\" in " << spec
+                      << " (expected category=error|warning|note|progress|other, color=RRGGBB or weight=1..100)"
+                      << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+WorldState::WorldState() {
+    for (size_t i = 0; i < TEXT_CATEGORY_COUNT; i++) {
+        palette.push_back(textCategoryColor(static_cast<TextCategory>(i)));
+    }
+}
+
+static std::vector<uint32_t> weightsOf(const std::vector<SourceLane>& lanes) {
+    std::vector<uint32_t> weights;
+    for (const SourceLane& lane : lanes) weights.push_back(lane.weight);
+    return weights;
+}
+
+Simulation::Simulation(const std::vector<SourceLane>& sourceLanes)
+    : lanes(sourceLanes),
+      laneWeights(weightsOf(sourceLanes)),
+      scheduler(SpawnConfig(), laneWeights),
+      pacedTurns(laneWeights),
+      collisionHits(world.fallingTexts.capacity()),
+      layoutGlyphs(MAX_TEXT_BYTES + 1),
+      heldLine(MAX_TEXT_BYTES) {
+    for (const SourceLane& lane : lanes) {
+        world.palette.push_back(lane.color);
+    }
+    world.spawnedByLane.assign(lanes.size(), 0);
+}
+
+bool Simulation::mergeRepeat(std::string_view line, size_t lane, uint64_t& hash) {
+    if (!dedupConfig.enabled) return false;
+    line = line.substr(0, MAX_TEXT_BYTES);
+    hash = hashLine(line, lane, dedupConfig.normalize);
+    TextStore& texts = world.fallingTexts;
+    uint32_t handle = repeatTable.find(hash, texts);
+    if (handle == TextArena::INVALID_HANDLE) return false;
+    size_t index = texts.find(handle);
+    if (!dedupConfig.normalize && texts.text(index) != line) return false;
+
+    // The counter is part of the text's box, so it widens as it counts
+    char counter[24];
+    uint32_t count = texts.repeats(index);
+    float lineWidth = texts.width[index];
+    if (count > 1) {
+        lineWidth -= getTextWidth(std::string_view(counter, formatRepeatCount(count, counter, sizeof(counter))),
+                                  textScale);
+    }
+    size_t length = formatRepeatCount(count + 1, counter, sizeof(counter));
+    float counterWidth = getTextWidth(std::string_view(counter, length), textScale);
+    if (texts.x[index] + lineWidth + counterWidth > SCREEN_X_PIXELS) {
+        // Cut the line shorter to keep the counter on screen. Should the
+        // layout not fit where the old one was, the line falls on its own.
+        size_t glyphCount = layOut(texts.text(index), texts.x[index], SCREEN_X_PIXELS - counterWidth, lineWidth);
+        if (!texts.setLayout(handle, layoutGlyphs.data(), glyphCount)) return false;
+    }
+    texts.addRepeat(index, lineWidth + counterWidth);
+    dedupCounters.linesMerged++;
+    dedupCounters.bytesMerged += line.size();
+    return true;
+}
+
+size_t Simulation::layOut(std::string_view line, float x, float clipRight, float& width) {
+    return layoutText(line, x, textScale, 0.0f, clipRight, layoutGlyphs.data(), layoutGlyphs.size(), width);
+}
+
+Simulation::SpawnResult Simulation::spawnText(std::string_view line, TextCategory category, float x, size_t lane) {
+    uint64_t hash = 0;
+    if (mergeRepeat(line, lane, hash)) return SpawnResult::Merged;
+
+    // A text keeps its lane's colour unless a pattern gave it a category of
+    // its own
+    uint8_t palette = static_cast<uint8_t>(category);
+    if (lane != NO_LANE && category == lanes[lane].category) {
+        palette = static_cast<uint8_t>(TEXT_CATEGORY_COUNT + lane);
+    }
+
+    // Copied once, into the store's text arena, and laid out once: the box
+    // is what is drawn, so anything cut off at the right edge can't be hit
+    line = line.substr(0, MAX_TEXT_BYTES);
+    float width;
+    size_t glyphCount = layOut(line, x, SCREEN_X_PIXELS, width);
+    uint32_t handle;
+    if (!world.fallingTexts.spawn(line, category, palette, x, 850.0f, 50.0f, width, getTextHeight(textScale),
+                                  layoutGlyphs.data(), glyphCount, &handle)) {
+        return SpawnResult::StoreFull;
+    }
+    world.spawnedTexts++;
+    world.spawnedByCategory[static_cast<size_t>(category)]++;
+    if (lane != NO_LANE) world.spawnedByLane[lane]++;
+    if (dedupConfig.enabled) repeatTable.remember(hash, handle);
+    return SpawnResult::Spawned;
+}
+
+void Simulation::holdLine(std::string_view line, TextCategory category, float x, size_t lane) {
+    heldLength = line.copy(heldLine.data(), heldLine.size());
+    heldCategory = category;
+    heldX = x;
+    heldLane = lane;
+    hasHeldLine = true;
+    world.heldSpawns++;
+}
+
+bool Simulation::spawnHeld() {
+    if (!hasHeldLine) return true;
+    std::string_view line(heldLine.data(), heldLength);
+    if (spawnText(line, heldCategory, heldX, heldLane) == SpawnResult::StoreFull) return false;
+    hasHeldLine = false;
+    return true;
+}
+
+// Archived logs: one line every baseInterval seconds, the lanes taking
+// turns by weight. A lane with nothing left passes its turn on. Repeats of
+// a falling text don't use up a turn, so a run of them is read through
+// (up to maxLinesPerStep) to the next line that spawns.
+void Simulation::spawnPaced(float deltaTime) {
+    textSpawnTimer += deltaTime;
+    if (textSpawnTimer < spawnConfig.baseInterval) return;
+    textSpawnTimer = 0.0f;
+
+    // A line the store had no room for takes this turn before a new one
+    if (hasHeldLine) {
+        spawnHeld();
+        return;
+    }
+
+    std::string_view nextLine;
+    size_t merged = 0;
+    for (uint64_t attempt = 0; attempt < pacedTurns.cycleLength(); attempt++) {
+        size_t lane = pacedTurns.next([](size_t) { return true; });
+        while (lanes[lane].source->nextLine(nextLine)) {
+            TextCategory category = classifier.classify(nextLine, lanes[lane].category);
+            SpawnResult result = spawnText(nextLine, category, 150.0f, lane);
+            if (result == SpawnResult::StoreFull) holdLine(nextLine, category, 150.0f, lane);
+            if (result != SpawnResult::Merged) return;
+            if (++merged == spawnConfig.maxLinesPerStep) return;
+        }
+    }
+}
+
+// Live logs: everything that arrived goes through the scheduler, which
+// decides what falls and when
+void Simulation::spawnRealTime(float deltaTime) {
+    std::string_view line;
+    for (size_t lane = 0; lane < lanes.size(); lane++) {
+        LineSource& source = *lanes[lane].source;
+        for (size_t i = 0; i < spawnConfig.maxLinesPerStep && source.nextLine(line); i++) {
+            // Repeats of what is falling never reach the backlog
+            uint64_t hash;
+            if (mergeRepeat(line, lane, hash)) continue;
+            scheduler.push(line, classifier.classify(line, lanes[lane].category), lane, simTime);
+        }
+    }
+    scheduler.advance(simTime, deltaTime);
+
+    // A line the store had no room for goes before anything new; while it
+    // still doesn't fit, nothing else would
+    if (!spawnHeld()) return;
+
+    // Above the base rate texts would land on top of each other, so they
+    // take turns across a few columns
+    TextCategory category;
+    size_t lane;
+    while (scheduler.next(world.fallingTexts.size(), line, category, lane)) {
+        float x = spawnColumns[spawnColumn];
+        spawnColumn = (spawnColumn + 1) % (sizeof(spawnColumns) / sizeof(spawnColumns[0]));
+        if (spawnText(line, category, x, lane) == SpawnResult::StoreFull) {
+            holdLine(line, category, x, lane);
+            break;
+        }
+    }
+}
+
+void Simulation::step(const SimInput& input) {
+    float deltaTime = input.deltaTime;
+
+    // Move the player
+    if (input.moveLeft)
+        world.playerX -= playerMoveSpeed * deltaTime;
+    if (input.moveRight)
+        world.playerX += playerMoveSpeed * deltaTime;
+
+    // Clamp player position to stay within bounds
+    if (world.playerX < -playerMaxX) world.playerX = -playerMaxX;
+    if (world.playerX > playerMaxX) world.playerX = playerMaxX;
+
+    simTime += deltaTime;
+    if (!world.isGameOver) {
+        ScopedPhase phase(profiler, "spawn");
+        if (spawnConfig.realTime) {
+            spawnRealTime(deltaTime);
+        } else {
+            spawnPaced(deltaTime);
+        }
+    }
+
+    TextStore& texts = world.fallingTexts;
+    {
+        ScopedPhase phase(profiler, "update");
+        texts.integrate(deltaTime);
+        texts.removeBelow(0.0f);
+    }
+
+    ScopedPhase collisionPhase(profiler, "collision");
+
+    // Check for collisions with player: broadphase picks the contiguous run
+    // of texts level with it, the vector kernel tests just that run
+    float playerPixelX = (world.playerX * SCREEN_Y_PIXELS/2.0f) + SCREEN_Y_PIXELS/2.0f;
+    float playerPixelY = (world.playerY * SCREEN_Y_PIXELS/2.0f) + SCREEN_Y_PIXELS/2.0f;
+    float playerPixelSize = playerSize * SCREEN_Y_PIXELS/2.0f;
+    Aabb playerBox = { playerPixelX - playerPixelSize, playerPixelX + playerPixelSize,
+                       playerPixelY - playerPixelSize, playerPixelY + playerPixelSize };
+    std::pair<size_t, size_t> band = texts.band(playerBox.minY, playerBox.maxY, getTextHeight(textScale));
+
+    size_t candidates = band.second - band.first;
+    size_t hits = collideAabb(texts.x.data() + band.first, texts.y.data() + band.first,
+                              texts.width.data() + band.first, texts.height.data() + band.first,
+                              candidates, playerBox, collisionHits.data());
+
+    // The most harmful text being touched sets the damage
+    float damage = 0.0f;
+    world.isColliding = hits > 0;
+    for (size_t i = 0; i < hits; i++) {
+        float textDamage = categoryDamage(texts.category[band.first + collisionHits[i]]);
+        if (textDamage > damage) damage = textDamage;
+    }
+
+    // Apply damage from error and warning collisions
+    if (damage > 0.0f && !world.isGameOver) {
+        damageTimer += deltaTime;
+        if (damageTimer >= damageInterval) {
+            damageTimer = 0.0f;
+            world.playerHealth -= damage;
+            if (world.playerHealth <= 0.0f) {
+                world.playerHealth = 0.0f;
+                world.isGameOver = true;
+            }
+        }
+    } else {
+        damageTimer = 0.0f;  // Reset timer when not colliding
+    }
+}
@@ -0,0 +1,151 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "classifier.h"
+#include "line_dedup.h"
+#include "log_reader.h"
+#include "profiler.h"
+#include "spawn_scheduler.h"
+#include "text_store.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define SCREEN_X_PIXELS 1200.0f
+#define SCREEN_Y_PIXELS 1200.0f
+
+// Inputs one game can follow at once; lane numbers are kept in a byte
+#define MAX_SOURCE_LANES 64
+
+// Everything the game logic needs from the outside world for one step
+struct SimInput {
+    float deltaTime = 0.0f;
+    bool moveLeft = false;
+    bool moveRight = false;
+};
+
+// One input to the game (a log file, or a build's stdout or stderr) and how
+// its lines look
+struct SourceLane {
+    LineSource* source = nullptr;
+    std::string name;
+    // Lines no classifier pattern puts anywhere else get this category,
+    // and texts in it are drawn in the lane's colour
+    TextCategory category = TextCategory::Other;
+    Color color = { 0.0f, 1.0f, 0.0f };
+    // Share of the spawns when several lanes have lines waiting
+    uint32_t weight = 1;
+};
+
+// Lane index of a game given plain file names: the first is the red error
+// lane and the second the green one, as the game has always had; any more
+// cycle through colours that don't look like a severity.
+SourceLane defaultSourceLane(size_t index);
+
+// Parses a lane given on the command line, "PATH[,category=NAME]
+// [,color=RRGGBB][,weight=N]", over the defaults already in lane. Prints
+// the problem and returns false if an option is malformed.
+bool parseLaneSpec(const std::string& spec, std::string& path, SourceLane& lane);
+
+struct WorldState {
+    WorldState();
+
+    TextStore fallingTexts;
+    // Colours texts are drawn in, indexed by TextStore::palette: the
+    // category colours, then one per lane
+    std::vector<Color> palette;
+    float playerX = 0.0f;
+    float playerY = -0.7f;
+    float playerHealth = 100.0f;
+    float maxHealth = 100.0f;
+    bool isColliding = false;
+    bool isGameOver = false;
+    uint64_t spawnedTexts = 0;
+    uint64_t spawnedByCategory[TEXT_CATEGORY_COUNT] = {};  // indexed by TextCategory
+    std::vector<uint64_t> spawnedByLane;
+    // Lines the store had no room for, kept back to spawn in a later step
+    uint64_t heldSpawns = 0;
+};
+
+bool checkCollision(float playerX, float playerY, float playerSize,
+                    float textX, float textY, float textWidth, float textHeight);
+
+// Spawning, falling, collision, damage and game-over logic. Has no
+// dependency on GL or GLFW: the caller supplies the timestep and key state
+// and reads back the world state, so it runs the same with or without a
+// window.
+class Simulation {
+public:
+    // At least one lane, at most MAX_SOURCE_LANES; their sources must
+    // outlive the simulation
+    explicit Simulation(const std::vector<SourceLane>& sourceLanes);
+
+    void step(const SimInput& input);
+
+    // Times the spawn, update and collision phases of each step
+    void setProfiler(FrameProfiler* frameProfiler) { profiler = frameProfiler; }
+
+    // Replaces the default patterns lines are tagged with. Lines matching
+    // none keep their lane's category.
+    void setClassifier(const LineClassifier& lineClassifier) { classifier = lineClassifier; }
+
+    // How lines are picked for spawning; see SpawnConfig. Call before the
+    // first step.
+    void setSpawnConfig(const SpawnConfig& config) { spawnConfig = config; scheduler = SpawnScheduler(config, laneWeights); }
+    const SpawnStats& spawnStats() const { return scheduler.stats(); }
+
+    // Whether repeats of a falling text merge into it; call before the
+    // first step
+    void setDedupConfig(const DedupConfig& config) { dedupConfig = config; }
+    const DedupStats& dedupStats() const { return dedupCounters; }
+
+    const WorldState& state() const { return world; }
+    const std::vector<SourceLane>& sourceLanes() const { return lanes; }
+
+private:
+    std::vector<SourceLane> lanes;
+    std::vector<uint32_t> laneWeights;
+    WorldState world;
+    LineClassifier classifier;
+    void spawnPaced(float deltaTime);
+    void spawnRealTime(float deltaTime);
+    enum class SpawnResult { Spawned, Merged, StoreFull };
+    // Merged if the line only added to the counter of a text that is
+    // already falling; StoreFull if the store had no room for it
+    SpawnResult spawnText(std::string_view line, TextCategory category, float x, size_t lane);
+    // Keeps a line the store had no room for, to go before any other
+    void holdLine(std::string_view line, TextCategory category, float x, size_t lane);
+    // Tries the held line again; false if it is still held
+    bool spawnHeld();
+    // Adds line to the counter of the falling text it repeats, if there is
+    // one; hash is left set for remembering the line otherwise
+    bool mergeRepeat(std::string_view line, size_t lane, uint64_t& hash);
+    // Lays line out from x up to clipRight into layoutGlyphs and returns
+    // the glyph count
+    size_t layOut(std::string_view line, float x, float clipRight, float& width);
+
+    SpawnConfig spawnConfig;
+    SpawnScheduler scheduler;
+    double simTime = 0.0;
+    size_t spawnColumn = 0;
+    float textSpawnTimer = 0.0f;
+    float damageTimer = 0.0f;
+    WeightedTurns pacedTurns;
+    DedupConfig dedupConfig;
+    DedupStats dedupCounters;
+    RepeatTable repeatTable;
+    FrameProfiler* profiler = nullptr;
+    // Scratch for collideAabb, sized once for a full store
+    std::vector<uint32_t> collisionHits;
+    // Scratch for layoutText, sized for the longest line kept
+    std::vector<LayoutGlyph> layoutGlyphs;
+    // The line last refused by a full store, if hasHeldLine
+    std::vector<char> heldLine;
+    size_t heldLength = 0;
+    TextCategory heldCategory = TextCategory::Other;
+    float heldX = 0.0f;
+    size_t heldLane = NO_LANE;
+    bool hasHeldLine = false;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "spawn_scheduler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// Skipped lines are summed up on screen at most this often
+static const double summaryInterval = 1.0;
+
+WeightedTurns::WeightedTurns(const std::vector<uint32_t>& laneWeights)
+    : weights(laneWeights.begin(), laneWeights.end()), current(laneWeights.size(), 0) {
+    for (int64_t weight : weights) totalWeight += static_cast<uint64_t>(weight);
+}
+
+SpawnScheduler::LineSlots::LineSlots(size_t capacity)
+    : bytes(capacity * MAX_TEXT_BYTES), lengths(capacity, 0) {
+    freeSlots.reserve(capacity);
+    for (size_t i = capacity; i > 0; i--) freeSlots.push_back(static_cast<uint32_t>(i - 1));
+}
+
+uint32_t SpawnScheduler::LineSlots::store(std::string_view line) {
+    if (freeSlots.empty()) return TextArena::INVALID_HANDLE;
+    uint32_t handle = freeSlots.back();
+    freeSlots.pop_back();
+    line = line.substr(0, MAX_TEXT_BYTES);
+    line.copy(bytes.data() + static_cast<size_t>(handle) * MAX_TEXT_BYTES, line.size());
+    lengths[handle] = static_cast<uint32_t>(line.size());
+    return handle;
+}
+
+SpawnScheduler::SpawnScheduler(const SpawnConfig& spawnConfig, const std::vector<uint32_t>& laneWeights)
+    : config(spawnConfig),
+      lines(spawnConfig.backlogLines + 1),
+      errors(spawnConfig.backlogLines),
+      others(laneWeights.size(), EntryQueue(spawnConfig.backlogLines)),
+      weights(laneWeights),
+      turns(laneWeights) {
+    summary[0] = '\0';
+}
+
+void SpawnScheduler::drop(EntryQueue& queue, uint64_t& counter) {
+    const Entry& entry = queue.front();
+    if (entry.category == TextCategory::Error) {
+        counters.errorsDropped++;
+        skippedErrors++;
+    }
+    lines.release(entry.handle);
+    queue.pop();
+    if (&queue != &errors) othersWaiting--;
+    counter++;
+    skipped++;
+}
+
+void SpawnScheduler::releaseHeld() {
+    if (heldHandle == TextArena::INVALID_HANDLE) return;
+    lines.release(heldHandle);
+    heldHandle = TextArena::INVALID_HANDLE;
+}
+
+SpawnScheduler::EntryQueue* SpawnScheduler::overflowVictim() {
+    EntryQueue* victim = nullptr;
+    uint32_t victimWeight = 1;
+    for (size_t lane = 0; lane < others.size(); lane++) {
+        if (others[lane].empty()) continue;
+        // size / weight > victim size / victim weight, without dividing
+        if (!victim || others[lane].size() * victimWeight > victim->size() * weights[lane]) {
+            victim = &others[lane];
+            victimWeight = weights[lane];
+        }
+    }
+    return victim;
+}
+
+void SpawnScheduler::push(std::string_view line, TextCategory category, size_t lane, double now) {
+    counters.linesIn++;
+    bool isError = category == TextCategory::Error;
+    EntryQueue& queue = isError ? errors : others[lane];
+
+    // Make room: a non-error line goes first, whichever queue is arriving
+    if (backlogSize() == config.backlogLines) {
+        if (EntryQueue* victim = overflowVictim()) {
+            drop(*victim, counters.droppedOverflow);
+        } else if (isError) {
+            drop(errors, counters.droppedOverflow);
+        } else {
+            // Everything waiting is an error; this line loses
+            counters.droppedOverflow++;
+            skipped++;
+            return;
+        }
+    }
+
+    // With room made there is always a slot: one per backlog line, and one
+    // for the line held since next()
+    uint32_t handle = lines.store(line);
+    queue.push({ handle, category, static_cast<uint8_t>(lane), now });
+    if (!isError) othersWaiting++;
+}
+
+void SpawnScheduler::advance(double now, float deltaTime) {
+    clock = now;
+    double cutoff = now - config.maxLag;
+    for (EntryQueue& queue : others) {
+        while (!queue.empty() && queue.front().arrival < cutoff) drop(queue, counters.droppedStale);
+    }
+    while (!errors.empty() && errors.front().arrival < cutoff) drop(errors, counters.droppedStale);
+
+    // Enough to clear the backlog within maxLag, between the base and
+    // maximum rates. The budget is capped at one spawn so an idle spell
+    // doesn't turn into a burst.
+    float rate = static_cast<float>(backlogSize()) / config.maxLag;
+    rate = std::clamp(rate, 1.0f / config.baseInterval, config.maxRate);
+    budget = std::min(budget + rate * deltaTime, 1.0f);
+
+    double oldest = now;
+    if (!errors.empty()) oldest = std::min(oldest, errors.front().arrival);
+    for (const EntryQueue& queue : others) {
+        if (!queue.empty()) oldest = std::min(oldest, queue.front().arrival);
+    }
+    counters.spawnRate = rate;
+    counters.lagSeconds = static_cast<float>(now - oldest);
+    counters.backlog = backlogSize();
+}
+
+bool SpawnScheduler::next(size_t onScreen, std::string_view& line, TextCategory& category, size_t& lane) {
+    releaseHeld();
+    if (budget < 1.0f || onScreen >= config.maxOnScreen) return false;
+
+    if (skipped > 0 && clock - lastSummary >= summaryInterval) {
+        if (skippedErrors > 0) {
+            std::snprintf(summary, sizeof(summary), "... %llu lines skipped (%llu errors)",
+                          static_cast<unsigned long long>(skipped), static_cast<unsigned long long>(skippedErrors));
+        } else {
+            std::snprintf(summary, sizeof(summary), "... %llu lines skipped",
+                          static_cast<unsigned long long>(skipped));
+        }
+        line = summary;
+        category = TextCategory::Progress;
+        lane = NO_LANE;
+        skipped = skippedErrors = 0;
+        lastSummary = clock;
+        counters.summariesSpawned++;
+        budget -= 1.0f;
+        return true;
+    }
+
+    EntryQueue* queue = &errors;
+    if (errors.empty()) {
+        size_t turn = turns.next([this](size_t candidate) { return !others[candidate].empty(); });
+        if (turn == NO_LANE) return false;
+        queue = &others[turn];
+        othersWaiting--;
+    }
+
+    const Entry& entry = queue->front();
+    line = lines.get(entry.handle);
+    category = entry.category;
+    lane = entry.lane;
+    heldHandle = entry.handle;
+    queue->pop();
+    counters.linesSpawned++;
+    counters.backlog = backlogSize();
+    budget -= 1.0f;
+    return true;
+}
@@ -0,0 +1,178 @@
+#ifndef SPAWN_SCHEDULER_H
+#define SPAWN_SCHEDULER_H
+
+#include "text_store.h"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Lane given for texts that came from no lane (skip summaries)
+#define NO_LANE static_cast<size_t>(-1)
+
+// Smooth weighted round robin over lanes: over any run of turns each lane
+// gets a share in proportion to its weight, interleaved rather than in
+// bursts. With equal weights it is plain alternation.
+class WeightedTurns {
+public:
+    explicit WeightedTurns(const std::vector<uint32_t>& laneWeights = {});
+
+    size_t laneCount() const { return weights.size(); }
+    // Turns it takes for every lane to have had at least one
+    uint64_t cycleLength() const { return totalWeight; }
+
+    // The next lane whose turn it is among those eligible(lane) accepts, or
+    // NO_LANE if it accepts none
+    template <typename Eligible>
+    size_t next(Eligible eligible) {
+        size_t best = NO_LANE;
+        int64_t total = 0;
+        for (size_t lane = 0; lane < weights.size(); lane++) {
+            if (!eligible(lane)) continue;
+            current[lane] += weights[lane];
+            total += weights[lane];
+            if (best == NO_LANE || current[lane] > current[best]) best = lane;
+        }
+        if (best != NO_LANE) current[best] -= total;
+        return best;
+    }
+
+private:
+    std::vector<int64_t> weights;
+    std::vector<int64_t> current;
+    uint64_t totalWeight = 0;
+};
+
+struct SpawnConfig {
+    // Live logs: drain every lane each step and keep what is shown close to
+    // real time. Off for archived logs, which are replayed one line every
+    // baseInterval, lanes taking turns by weight, however much is waiting.
+    bool realTime = false;
+    float baseInterval = 0.5f;     // slowest spawn rate, 1 / baseInterval per second
+    float maxRate = 6.0f;          // spawns per second at most
+    float maxLag = 1.0f;           // lines waiting longer than this are skipped
+    size_t backlogLines = 256;     // lines held waiting to spawn
+    size_t maxOnScreen = 96;       // no spawns while this many texts are falling
+    size_t maxLinesPerStep = 4096; // taken from each lane per step
+};
+
+struct SpawnStats {
+    uint64_t linesIn = 0;
+    uint64_t linesSpawned = 0;
+    uint64_t summariesSpawned = 0;
+    uint64_t droppedOverflow = 0;  // pushed out of a full backlog
+    uint64_t droppedStale = 0;     // waited longer than maxLag
+    uint64_t errorsDropped = 0;    // of the two above, how many were errors
+    size_t backlog = 0;
+    float spawnRate = 0.0f;        // per second, as last computed
+    float lagSeconds = 0.0f;       // age of the oldest line waiting
+};
+
+// Decides which of the lines arriving from a live build get to fall, and
+// when. Lines wait in a bounded backlog, each in a fixed slot of its own.
+// Errors queue separately and always go first. Other lines queue per lane
+// and the lanes take turns by weight, so one chatty log can't crowd out the
+// rest. When the backlog is full the oldest line of the lane holding the
+// most for its weight is dropped (or, if everything waiting is an error,
+// the oldest error), and anything that has waited longer than maxLag is
+// skipped, so the screen never drifts more than about maxLag behind.
+//
+// The spawn rate follows the backlog: enough to clear it within maxLag,
+// never below the base rate or above maxRate, and paused while the screen
+// is full. Skipped lines aren't lost silently: they are coalesced into a
+// "... N lines skipped" text, at most one a second.
+class SpawnScheduler {
+public:
+    // One weight per lane lines can arrive on
+    explicit SpawnScheduler(const SpawnConfig& config = SpawnConfig(),
+                            const std::vector<uint32_t>& laneWeights = { 1 });
+
+    // Queues a line that arrived on lane at time now (seconds)
+    void push(std::string_view line, TextCategory category, size_t lane, double now);
+
+    // Moves the clock on: skips stale lines and refills the spawn budget
+    void advance(double now, float deltaTime);
+
+    // The next line to spawn, if the budget and screen allow, and the lane
+    // it came from (NO_LANE for a skip summary). The view stays valid until
+    // the next call.
+    bool next(size_t onScreen, std::string_view& line, TextCategory& category, size_t& lane);
+
+    const SpawnStats& stats() const { return counters; }
+
+private:
+    struct Entry {
+        uint32_t handle;
+        TextCategory category;
+        uint8_t lane;
+        double arrival;
+    };
+
+    // Fixed-capacity FIFO of backlog entries
+    class EntryQueue {
+    public:
+        explicit EntryQueue(size_t capacity) : entries(capacity) {}
+        bool empty() const { return count == 0; }
+        size_t size() const { return count; }
+        const Entry& front() const { return entries[head]; }
+        void push(const Entry& entry) {
+            entries[(head + count) % entries.size()] = entry;
+            count++;
+        }
+        void pop() {
+            head = (head + 1) % entries.size();
+            count--;
+        }
+
+    private:
+        std::vector<Entry> entries;
+        size_t head = 0;
+        size_t count = 0;
+    };
+
+    // Backlog text, a MAX_TEXT_BYTES slot per line found by its handle.
+    // Lines leave out of order (errors first, lanes by turns, overflow from
+    // the middle), so no slot's space depends on when another goes.
+    class LineSlots {
+    public:
+        explicit LineSlots(size_t capacity);
+        // Returns INVALID_HANDLE if every slot is in use
+        uint32_t store(std::string_view line);
+        void release(uint32_t handle) { freeSlots.push_back(handle); }
+        std::string_view get(uint32_t handle) const {
+            return std::string_view(bytes.data() + static_cast<size_t>(handle) * MAX_TEXT_BYTES, lengths[handle]);
+        }
+
+    private:
+        std::vector<char> bytes;
+        std::vector<uint32_t> lengths;
+        std::vector<uint32_t> freeSlots;
+    };
+
+    void drop(EntryQueue& queue, uint64_t& counter);
+    void releaseHeld();
+    // The lane queue to shed a line from: the longest for its weight
+    EntryQueue* overflowVictim();
+    size_t backlogSize() const { return errors.size() + othersWaiting; }
+
+    SpawnConfig config;
+    // The backlog, plus the line next() last handed out
+    LineSlots lines;
+    EntryQueue errors;
+    std::vector<EntryQueue> others;  // one per lane
+    std::vector<uint32_t> weights;
+    WeightedTurns turns;
+    size_t othersWaiting = 0;
+    uint32_t heldHandle = TextArena::INVALID_HANDLE;
+
+    double clock = 0.0;
+    float budget = 0.0f;
+    uint64_t skipped = 0;        // since the last summary
+    uint64_t skippedErrors = 0;
+    double lastSummary = 0.0;
+    char summary[96];
+
+    SpawnStats counters;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "stream_buffer.h"
+
+#include <GL/glew.h>
+#include <cstring>
+#include <iostream>
+
+// How long a blocked upload waits before giving up on a fence, in ns
+static const GLuint64 fenceTimeout = 1000000000ull;
+
+bool StreamBuffer::init(size_t segmentBytes, size_t alignBytes) {
+    align = alignBytes > 0 ? alignBytes : 1;
+    hasStorage = GLEW_ARB_buffer_storage;
+    return allocate(segmentBytes);
+}
+
+void StreamBuffer::destroy() {
+    release();
+}
+
+bool StreamBuffer::allocate(size_t segmentBytes) {
+    segmentSize = (segmentBytes + align - 1) / align * align;
+    size_t totalBytes = segmentSize * STREAM_BUFFER_SEGMENTS;
+    current = 0;
+
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    if (hasStorage) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, totalBytes, nullptr, flags);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, totalBytes, flags));
+        if (!mapped) {
+            // Some drivers advertise the extension but refuse the mapping
+            std::cerr << "Persistent mapping failed, streaming with glMapBufferRange" << std::endl;
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glDeleteBuffers(1, &VBO);
+            hasStorage = false;
+            return allocate(segmentBytes);
+        }
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, totalBytes, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+void StreamBuffer::release() {
+    for (auto& fence : fences) {
+        if (fence) glDeleteSync(static_cast<GLsync>(fence));
+        fence = nullptr;
+    }
+    if (mapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        mapped = nullptr;
+    }
+    glDeleteBuffers(1, &VBO);
+    VBO = 0;
+}
+
+bool StreamBuffer::waitForSegment(size_t index) {
+    GLsync fence = static_cast<GLsync>(fences[index]);
+    if (!fence) return true;
+
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        if (!persistent()) return false;  // the caller orphans instead
+        waits++;
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, fenceTimeout);
+    }
+    if (result == GL_WAIT_FAILED || result == GL_TIMEOUT_EXPIRED) {
+        std::cerr << "Stream buffer fence wait failed" << std::endl;
+    }
+    glDeleteSync(fence);
+    fences[index] = nullptr;
+    return true;
+}
+
+size_t StreamBuffer::upload(const void* data, size_t bytes) {
+    if (bytes > segmentSize) {
+        // Deleting a buffer the GPU still reads is safe; GL keeps the storage
+        // alive until those draws are done
+        size_t grown = segmentSize;
+        while (grown < bytes) grown *= 2;
+        release();
+        allocate(grown);
+    }
+
+    size_t offset = current * segmentSize;
+    bool segmentFree = waitForSegment(current);
+
+    if (persistent()) {
+        std::memcpy(mapped + offset, data, bytes);
+        return offset;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    if (segmentFree) {
+        access |= GL_MAP_INVALIDATE_RANGE_BIT;
+    } else {
+        // Orphan: the driver hands over fresh storage and keeps the old one
+        // for the draws still using it. Every segment is free again.
+        orphaned++;
+        glBufferData(GL_ARRAY_BUFFER, segmentSize * STREAM_BUFFER_SEGMENTS, nullptr, GL_STREAM_DRAW);
+        for (auto& fence : fences) {
+            if (fence) glDeleteSync(static_cast<GLsync>(fence));
+            fence = nullptr;
+        }
+    }
+    void* target = glMapBufferRange(GL_ARRAY_BUFFER, offset, bytes, access);
+    if (target) {
+        std::memcpy(target, data, bytes);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, data);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return offset;
+}
+
+void StreamBuffer::fence() {
+    if (fences[current]) glDeleteSync(static_cast<GLsync>(fences[current]));
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    current = (current + 1) % STREAM_BUFFER_SEGMENTS;
+}
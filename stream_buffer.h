@@ -0,0 +1,59 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// One for the CPU to fill, one the GPU may be drawing from, one queued
+#define STREAM_BUFFER_SEGMENTS 3
+
+// A vertex buffer for data rewritten every frame, split into a ring of
+// segments. Each upload fills the next segment, and a fence placed after the
+// draws that read it says when the GPU is done with it, so the CPU only
+// waits if it laps the GPU, and the driver never has to stall a
+// glBufferSubData behind a draw still in flight.
+//
+// With ARB_buffer_storage the whole buffer is mapped once, persistent and
+// coherent, and uploads are plain memcpys. On plain GL 3.3 each segment is
+// mapped unsynchronized with glMapBufferRange, and if its fence hasn't
+// signalled yet the buffer is orphaned rather than waited on.
+class StreamBuffer {
+public:
+    // segmentBytes is rounded up to a whole number of vertices of alignBytes
+    bool init(size_t segmentBytes, size_t alignBytes);
+    void destroy();
+
+    // Copies bytes into the next segment and returns its offset in the
+    // buffer. If they don't fit, the buffer is reallocated with bigger
+    // segments under a new id, so callers must re-point their vertex
+    // attributes whenever buffer() changes.
+    size_t upload(const void* data, size_t bytes);
+
+    // Call once the draws reading the last upload have been issued
+    void fence();
+
+    unsigned int buffer() const { return VBO; }
+    bool persistent() const { return mapped != nullptr; }
+
+    // Uploads that found their segment still in use by the GPU and blocked
+    uint64_t fenceWaits() const { return waits; }
+    // Fallback path only: uploads that orphaned the buffer instead
+    uint64_t orphans() const { return orphaned; }
+
+private:
+    bool allocate(size_t segmentBytes);
+    void release();
+    bool waitForSegment(size_t index);
+
+    unsigned int VBO = 0;
+    size_t align = 1;
+    size_t segmentSize = 0;
+    size_t current = 0;
+    bool hasStorage = false;
+    unsigned char* mapped = nullptr;
+    void* fences[STREAM_BUFFER_SEGMENTS] = {};
+    uint64_t waits = 0;
+    uint64_t orphaned = 0;
+};
+
+#endif
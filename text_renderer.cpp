@@ -0,0 +1,128 @@
+#include "text_renderer.h"
+
+#include <GL/glew.h>
+
+void TextBatch::init(unsigned int textShader) {
+    shader = textShader;
+
+    glGenTextures(1, &atlasTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlasTexture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenVertexArrays(1, &VAO);
+    vertexStream.init(sizeof(float) * TEXT_VERTEX_FLOATS * 6 * 1024, sizeof(float) * TEXT_VERTEX_FLOATS);
+    bindVertexStream();
+}
+
+// Points the vertex attributes at the stream's buffer, which changes when
+// the stream grows
+void TextBatch::bindVertexStream() {
+    boundBuffer = vertexStream.buffer();
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, boundBuffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, TEXT_VERTEX_FLOATS * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, TEXT_VERTEX_FLOATS * sizeof(float),
+                          (void*)(4 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, TEXT_VERTEX_FLOATS * sizeof(float),
+                          (void*)(5 * sizeof(float)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void TextBatch::destroy() {
+    glDeleteVertexArrays(1, &VAO);
+    vertexStream.destroy();
+    glDeleteTextures(1, &atlasTexture);
+    VAO = boundBuffer = atlasTexture = 0;
+    atlasLayers = 0;
+}
+
+void TextBatch::uploadGlyphPages() {
+    size_t pageCount = glyphCache.pageCount();
+    bool anyDirty = pageCount > atlasLayers;
+    for (size_t i = 0; i < pageCount && !anyDirty; i++) {
+        anyDirty = glyphCache.page(i).dirtyMaxY > glyphCache.page(i).dirtyMinY;
+    }
+    // Usually nothing changed, and then no texture is bound at all
+    if (!anyDirty) return;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlasTexture);
+    counters.stateChanges += 2;
+    if (pageCount > atlasLayers) {
+        // A texture array can't grow in place: reallocate it with room for
+        // the new page and upload every page again. Only happens until the
+        // cache reaches its budget.
+        atlasLayers = pageCount;
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R8, GLYPH_PAGE_SIZE, GLYPH_PAGE_SIZE,
+                     static_cast<GLsizei>(atlasLayers), 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+        counters.textureUploads++;
+        for (size_t i = 0; i < pageCount; i++) {
+            glyphCache.page(i).dirtyMinY = 0;
+            glyphCache.page(i).dirtyMaxY = GLYPH_PAGE_SIZE;
+        }
+    }
+    for (size_t i = 0; i < pageCount; i++) {
+        GlyphPage& page = glyphCache.page(i);
+        if (page.dirtyMaxY <= page.dirtyMinY) continue;
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, page.dirtyMinY, static_cast<GLint>(i),
+                        GLYPH_PAGE_SIZE, page.dirtyMaxY - page.dirtyMinY, 1, GL_RED, GL_UNSIGNED_BYTE,
+                        &page.pixels[page.dirtyMinY * GLYPH_PAGE_SIZE]);
+        counters.textureUploads++;
+        counters.uploadedBytes += static_cast<uint64_t>(page.dirtyMaxY - page.dirtyMinY) * GLYPH_PAGE_SIZE;
+        page.dirtyMinY = page.dirtyMaxY = 0;
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    counters.stateChanges++;
+}
+
+void TextBatch::addText(std::string_view text, float x, float y, float scale,
+                        float r, float g, float b, float clipRight) {
+    appendTextQuads(vertices, text, x, y, scale, r, g, b, clipRight);
+}
+
+void TextBatch::addLayout(const LayoutGlyph* glyphs, size_t glyphCount, float x, float y, float scale,
+                          float r, float g, float b) {
+    appendLayoutQuads(vertices, glyphs, glyphCount, x, y, scale, r, g, b);
+}
+
+void TextBatch::flush() {
+    if (vertices.empty()) {
+        glyphCache.endFrame();
+        return;
+    }
+
+    uploadGlyphPages();
+    size_t bytes = vertices.size() * sizeof(float);
+    size_t offset = vertexStream.upload(vertices.data(), bytes);
+    if (vertexStream.buffer() != boundBuffer) bindVertexStream();
+    counters.bufferUploads++;
+    counters.uploadedBytes += bytes;
+    // Without a persistent mapping the stream binds its buffer to map it
+    if (!vertexStream.persistent()) counters.stateChanges += 2;
+
+    // Segments start on a vertex boundary, so the draw can begin there
+    // without re-pointing the attributes
+    const size_t vertexBytes = TEXT_VERTEX_FLOATS * sizeof(float);
+    glUseProgram(shader);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlasTexture);
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, static_cast<GLint>(offset / vertexBytes),
+                 static_cast<GLsizei>(vertices.size() / TEXT_VERTEX_FLOATS));
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    vertexStream.fence();
+    counters.drawCalls++;
+    counters.stateChanges += 6;
+
+    vertices.clear();
+    glyphCache.endFrame();
+}
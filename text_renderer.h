@@ -0,0 +1,50 @@
+#ifndef TEXT_RENDERER_H
+#define TEXT_RENDERER_H
+
+#include "font.h"
+#include "render_stats.h"
+#include "stream_buffer.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Collects the quads for every piece of text drawn in a frame and submits
+// them with one draw call. The glyph cache's pages live in one texture
+// array, one layer per page, and each vertex says which layer to sample;
+// pages touched since the last flush are uploaded first. Vertices stream
+// through a StreamBuffer, so a flush never waits on last frame's draw.
+class TextBatch {
+public:
+    void init(unsigned int shader);
+    void destroy();
+
+    // Glyphs starting at or past clipRight are left out
+    void addText(std::string_view text, float x, float y, float scale,
+                 float r, float g, float b, float clipRight = std::numeric_limits<float>::infinity());
+    // A text laid out ahead of time by layoutText
+    void addLayout(const LayoutGlyph* glyphs, size_t glyphCount, float x, float y, float scale,
+                   float r, float g, float b);
+    void flush();
+
+    // Uploads glyph pages added or changed since the last call. flush()
+    // does this itself; calling it at startup moves the upload of cached
+    // pages out of the first frame.
+    void uploadGlyphPages();
+
+    const StreamBuffer& stream() const { return vertexStream; }
+    const RenderStats& stats() const { return counters; }
+
+private:
+    void bindVertexStream();
+
+    unsigned int shader = 0;
+    unsigned int atlasTexture = 0;
+    size_t atlasLayers = 0;
+    unsigned int VAO = 0;
+    unsigned int boundBuffer = 0;
+    StreamBuffer vertexStream;
+    std::vector<float> vertices;
+    RenderStats counters;
+};
+
+#endif
@@ -0,0 +1,442 @@
+#include "text_store.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TEXT_KERNELS_X86 1
+#endif
+
+// Scalar kernels: the reference every vector version must match exactly
+
+static void integratePositionsScalar(float* y, const float* speed, size_t count, float deltaTime) {
+    for (size_t i = 0; i < count; i++) {
+        y[i] -= speed[i] * deltaTime;
+    }
+}
+
+static size_t countPrefixBelowScalar(const float* y, size_t count, float limit) {
+    size_t i = 0;
+    while (i < count && y[i] < limit) i++;
+    return i;
+}
+
+static size_t collideAabbScalar(const float* x, const float* y, const float* width, const float* height,
+                                size_t count, const Aabb& box, uint32_t* hitIndices) {
+    size_t hits = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (box.minX < x[i] + width[i] && box.maxX > x[i] &&
+            box.minY < y[i] + height[i] && box.maxY > y[i]) {
+            hitIndices[hits++] = static_cast<uint32_t>(i);
+        }
+    }
+    return hits;
+}
+
+#ifdef TEXT_KERNELS_X86
+
+static size_t emitHits(unsigned int mask, size_t base, uint32_t* hitIndices, size_t hits) {
+    while (mask) {
+        hitIndices[hits++] = static_cast<uint32_t>(base + __builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+    return hits;
+}
+
+// SSE2 is part of the x86-64 baseline, so these need no target attribute.
+// Multiply and subtract stay separate (no FMA) to round like the scalar code.
+
+static void integratePositionsSse2(float* y, const float* speed, size_t count, float deltaTime) {
+    __m128 dt = _mm_set1_ps(deltaTime);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_loadu_ps(y + i);
+        v = _mm_sub_ps(v, _mm_mul_ps(_mm_loadu_ps(speed + i), dt));
+        _mm_storeu_ps(y + i, v);
+    }
+    integratePositionsScalar(y + i, speed + i, count - i, deltaTime);
+}
+
+static size_t countPrefixBelowSse2(const float* y, size_t count, float limit) {
+    __m128 l = _mm_set1_ps(limit);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int mask = _mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(y + i), l));
+        if (mask != 0xF) return i + __builtin_ctz(~mask);
+    }
+    return i + countPrefixBelowScalar(y + i, count - i, limit);
+}
+
+static size_t collideAabbSse2(const float* x, const float* y, const float* width, const float* height,
+                              size_t count, const Aabb& box, uint32_t* hitIndices) {
+    __m128 minX = _mm_set1_ps(box.minX);
+    __m128 maxX = _mm_set1_ps(box.maxX);
+    __m128 minY = _mm_set1_ps(box.minY);
+    __m128 maxY = _mm_set1_ps(box.maxY);
+    size_t hits = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_loadu_ps(x + i);
+        __m128 vy = _mm_loadu_ps(y + i);
+        __m128 overlap = _mm_and_ps(
+            _mm_and_ps(_mm_cmplt_ps(minX, _mm_add_ps(vx, _mm_loadu_ps(width + i))), _mm_cmpgt_ps(maxX, vx)),
+            _mm_and_ps(_mm_cmplt_ps(minY, _mm_add_ps(vy, _mm_loadu_ps(height + i))), _mm_cmpgt_ps(maxY, vy)));
+        hits = emitHits(_mm_movemask_ps(overlap), i, hitIndices, hits);
+    }
+    size_t tail = collideAabbScalar(x + i, y + i, width + i, height + i, count - i, box, hitIndices + hits);
+    for (size_t t = hits; t < hits + tail; t++) hitIndices[t] += static_cast<uint32_t>(i);
+    return hits + tail;
+}
+
+// The AVX2 kernels fall back to scalar below one full vector: waking the
+// 256-bit units for a near-empty screen costs far more than it saves.
+
+__attribute__((target("avx2")))
+static void integratePositionsAvx2(float* y, const float* speed, size_t count, float deltaTime) {
+    if (count < 8) {
+        integratePositionsScalar(y, speed, count, deltaTime);
+        return;
+    }
+    __m256 dt = _mm256_set1_ps(deltaTime);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = _mm256_loadu_ps(y + i);
+        v = _mm256_sub_ps(v, _mm256_mul_ps(_mm256_loadu_ps(speed + i), dt));
+        _mm256_storeu_ps(y + i, v);
+    }
+    integratePositionsScalar(y + i, speed + i, count - i, deltaTime);
+}
+
+__attribute__((target("avx2")))
+static size_t countPrefixBelowAvx2(const float* y, size_t count, float limit) {
+    if (count < 8) return countPrefixBelowScalar(y, count, limit);
+    __m256 l = _mm256_set1_ps(limit);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(y + i), l, _CMP_LT_OQ));
+        if (mask != 0xFF) return i + __builtin_ctz(~mask);
+    }
+    return i + countPrefixBelowScalar(y + i, count - i, limit);
+}
+
+__attribute__((target("avx2")))
+static size_t collideAabbAvx2(const float* x, const float* y, const float* width, const float* height,
+                              size_t count, const Aabb& box, uint32_t* hitIndices) {
+    if (count < 8) return collideAabbScalar(x, y, width, height, count, box, hitIndices);
+    __m256 minX = _mm256_set1_ps(box.minX);
+    __m256 maxX = _mm256_set1_ps(box.maxX);
+    __m256 minY = _mm256_set1_ps(box.minY);
+    __m256 maxY = _mm256_set1_ps(box.maxY);
+    size_t hits = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 vx = _mm256_loadu_ps(x + i);
+        __m256 vy = _mm256_loadu_ps(y + i);
+        __m256 overlap = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(minX, _mm256_add_ps(vx, _mm256_loadu_ps(width + i)), _CMP_LT_OQ),
+                          _mm256_cmp_ps(maxX, vx, _CMP_GT_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(minY, _mm256_add_ps(vy, _mm256_loadu_ps(height + i)), _CMP_LT_OQ),
+                          _mm256_cmp_ps(maxY, vy, _CMP_GT_OQ)));
+        hits = emitHits(_mm256_movemask_ps(overlap), i, hitIndices, hits);
+    }
+    size_t tail = collideAabbScalar(x + i, y + i, width + i, height + i, count - i, box, hitIndices + hits);
+    for (size_t t = hits; t < hits + tail; t++) hitIndices[t] += static_cast<uint32_t>(i);
+    return hits + tail;
+}
+
+#endif
+
+struct TextKernels {
+    const char* name;
+    void (*integrate)(float*, const float*, size_t, float);
+    size_t (*countPrefixBelow)(const float*, size_t, float);
+    size_t (*collide)(const float*, const float*, const float*, const float*, size_t, const Aabb&, uint32_t*);
+};
+
+static const TextKernels scalarKernels = {
+    "scalar", integratePositionsScalar, countPrefixBelowScalar, collideAabbScalar
+};
+
+static TextKernels selectKernels() {
+#ifdef TEXT_KERNELS_X86
+    // Runs during static initialisation, possibly before libgcc's own
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return { "avx2", integratePositionsAvx2, countPrefixBelowAvx2, collideAabbAvx2 };
+    }
+    return { "sse2", integratePositionsSse2, countPrefixBelowSse2, collideAabbSse2 };
+#else
+    return scalarKernels;
+#endif
+}
+
+static const TextKernels bestKernels = selectKernels();
+static const TextKernels* kernels = &bestKernels;
+
+void integratePositions(float* y, const float* speed, size_t count, float deltaTime) {
+    kernels->integrate(y, speed, count, deltaTime);
+}
+
+size_t countPrefixBelow(const float* y, size_t count, float limit) {
+    return kernels->countPrefixBelow(y, count, limit);
+}
+
+size_t collideAabb(const float* x, const float* y, const float* width, const float* height,
+                   size_t count, const Aabb& box, uint32_t* hitIndices) {
+    return kernels->collide(x, y, width, height, count, box, hitIndices);
+}
+
+const char* textKernelName() {
+    return kernels->name;
+}
+
+void useScalarTextKernels(bool scalar) {
+    kernels = scalar ? &scalarKernels : &bestKernels;
+}
+
+Color textCategoryColor(TextCategory category) {
+    switch (category) {
+    case TextCategory::Error: return { 1.0f, 0.0f, 0.0f };
+    case TextCategory::Warning: return { 1.0f, 0.85f, 0.0f };
+    case TextCategory::Note: return { 0.3f, 0.8f, 1.0f };
+    case TextCategory::Progress: return { 0.6f, 0.6f, 0.6f };
+    case TextCategory::Other: break;
+    }
+    return { 0.0f, 1.0f, 0.0f };
+}
+
+TextArena::TextArena(size_t byteCapacity, size_t maxLines)
+    : bytes(byteCapacity), slots(maxLines), storeOrder(maxLines) {
+    freeSlots.reserve(maxLines);
+    clear();
+}
+
+void TextArena::clear() {
+    freeSlots.clear();
+    for (size_t i = slots.size(); i > 0; i--) {
+        slots[i - 1].live = false;
+        freeSlots.push_back(static_cast<uint32_t>(i - 1));
+    }
+    head = tail = 0;
+    orderHead = orderCount = 0;
+    liveCount = 0;
+    liveByteCount = 0;
+}
+
+uint32_t TextArena::store(std::string_view line, size_t reserveBytes) {
+    if (freeSlots.empty()) return INVALID_HANDLE;
+
+    // Live bytes are [tail, head) or, once wrapped, [tail, end) + [0, head).
+    // Strict comparisons keep head from catching up with tail, so
+    // head == tail always means empty.
+    size_t length = std::max(line.size(), reserveBytes);
+    size_t start;
+    if (liveCount == 0) {
+        head = tail = 0;
+    }
+    if (head >= tail) {
+        if (head + length <= bytes.size()) {
+            start = head;
+        } else if (length < tail) {
+            start = 0;
+        } else {
+            return INVALID_HANDLE;
+        }
+    } else if (head + length < tail) {
+        start = head;
+    } else {
+        return INVALID_HANDLE;
+    }
+
+    uint32_t handle = freeSlots.back();
+    freeSlots.pop_back();
+    line.copy(bytes.data() + start, line.size());
+    slots[handle] = { static_cast<uint32_t>(start), static_cast<uint32_t>(line.size()), static_cast<uint32_t>(length),
+                      true };
+    head = start + length;
+
+    storeOrder[(orderHead + orderCount) % storeOrder.size()] = handle;
+    orderCount++;
+    liveCount++;
+    liveByteCount += line.size();
+    return handle;
+}
+
+bool TextArena::rewrite(uint32_t handle, std::string_view line) {
+    Slot& slot = slots[handle];
+    if (line.size() > slot.reserved) return false;
+    line.copy(bytes.data() + slot.offset, line.size());
+    liveByteCount = liveByteCount - slot.length + line.size();
+    slot.length = static_cast<uint32_t>(line.size());
+    return true;
+}
+
+void TextArena::release(uint32_t handle) {
+    slots[handle].live = false;
+    liveCount--;
+    liveByteCount -= slots[handle].length;
+
+    // Reclaim ring space up to the oldest line that is still live. Handles
+    // go back to the pool only here: one freed out of order and stored
+    // again while still queued would move tail onto its new offset, past
+    // older lines that are live.
+    while (orderCount > 0 && !slots[storeOrder[orderHead]].live) {
+        freeSlots.push_back(storeOrder[orderHead]);
+        orderHead = (orderHead + 1) % storeOrder.size();
+        orderCount--;
+    }
+    // and take back the front of the ring from the newest lines that are
+    // gone, such as one stored only to be given up straight away
+    while (orderCount > 0) {
+        uint32_t newest = storeOrder[(orderHead + orderCount - 1) % storeOrder.size()];
+        if (slots[newest].live) break;
+        freeSlots.push_back(newest);
+        head = slots[newest].offset;
+        orderCount--;
+    }
+    if (orderCount > 0) {
+        tail = slots[storeOrder[orderHead]].offset;
+    }
+}
+
+TextStore::TextStore(size_t capacity, size_t bytesPerText)
+    : maxTexts(capacity),
+      arena(capacity * bytesPerText, capacity),
+      glyphArena(capacity * LAYOUT_GLYPHS_PER_TEXT * sizeof(LayoutGlyph), capacity),
+      repeatCounts(capacity, 0),
+      layoutHandles(capacity, TextArena::INVALID_HANDLE),
+      handleIndex(capacity, 0) {
+    static_assert(sizeof(LayoutGlyph) == 8, "layout records are read in place from the glyph arena");
+    x.reserve(capacity);
+    y.reserve(capacity);
+    speed.reserve(capacity);
+    width.reserve(capacity);
+    height.reserve(capacity);
+    category.reserve(capacity);
+    palette.reserve(capacity);
+    textHandle.reserve(capacity);
+}
+
+bool TextStore::spawn(std::string_view line, TextCategory textCategory, uint8_t textPalette, float textX, float textY,
+                      float textSpeed, float textWidth, float textHeight, const LayoutGlyph* glyphs, size_t glyphCount,
+                      uint32_t* spawnedHandle) {
+    if (size() == maxTexts) {
+        drops++;
+        return false;
+    }
+    uint32_t handle = arena.store(line.substr(0, MAX_TEXT_BYTES));
+    if (handle == TextArena::INVALID_HANDLE) {
+        drops++;
+        return false;
+    }
+    uint32_t glyphHandle = TextArena::INVALID_HANDLE;
+    if (glyphs) {
+        glyphHandle = glyphArena.store(std::string_view(reinterpret_cast<const char*>(glyphs),
+                                                        glyphCount * sizeof(LayoutGlyph)),
+                                       (glyphCount + 1) * sizeof(LayoutGlyph));
+        if (glyphHandle == TextArena::INVALID_HANDLE) {
+            arena.release(handle);
+            drops++;
+            return false;
+        }
+    }
+
+    x.push_back(textX);
+    y.push_back(textY);
+    speed.push_back(textSpeed);
+    width.push_back(textWidth);
+    height.push_back(textHeight);
+    category.push_back(textCategory);
+    palette.push_back(textPalette);
+    textHandle.push_back(handle);
+    repeatCounts[handle] = 1;
+    layoutHandles[handle] = glyphHandle;
+    if (spawnedHandle) *spawnedHandle = handle;
+
+    // New texts spawn at the top, so this is nearly always already in place
+    size_t last = size() - 1;
+    size_t position = std::upper_bound(y.begin(), y.end() - 1, textY) - y.begin();
+    handleIndex[handle] = static_cast<uint32_t>(last);
+    if (position != last) moveEntry(last, position);
+    return true;
+}
+
+void TextStore::integrate(float deltaTime) {
+    integratePositions(y.data(), speed.data(), size(), deltaTime);
+
+    // Texts falling at different speeds can overtake each other; put the
+    // few that moved back in place
+    for (size_t i = 1; i < size(); i++) {
+        if (y[i] >= y[i - 1]) continue;
+        size_t position = std::upper_bound(y.begin(), y.begin() + i, y[i]) - y.begin();
+        moveEntry(i, position);
+    }
+}
+
+size_t TextStore::removeBelow(float limit) {
+    size_t count = countPrefixBelow(y.data(), size(), limit);
+    if (count == 0) return 0;
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t& glyphHandle = layoutHandles[textHandle[i]];
+        if (glyphHandle != TextArena::INVALID_HANDLE) glyphArena.release(glyphHandle);
+        glyphHandle = TextArena::INVALID_HANDLE;
+        arena.release(textHandle[i]);
+    }
+    x.erase(x.begin(), x.begin() + count);
+    y.erase(y.begin(), y.begin() + count);
+    speed.erase(speed.begin(), speed.begin() + count);
+    width.erase(width.begin(), width.begin() + count);
+    height.erase(height.begin(), height.begin() + count);
+    category.erase(category.begin(), category.begin() + count);
+    palette.erase(palette.begin(), palette.begin() + count);
+    textHandle.erase(textHandle.begin(), textHandle.begin() + count);
+    for (size_t i = 0; i < size(); i++) handleIndex[textHandle[i]] = static_cast<uint32_t>(i);
+    return count;
+}
+
+bool TextStore::setLayout(uint32_t handle, const LayoutGlyph* glyphs, size_t glyphCount) {
+    uint32_t glyphHandle = layoutHandles[handle];
+    if (glyphHandle == TextArena::INVALID_HANDLE) return false;
+    return glyphArena.rewrite(glyphHandle, std::string_view(reinterpret_cast<const char*>(glyphs),
+                                                            glyphCount * sizeof(LayoutGlyph)));
+}
+
+void TextStore::addRepeat(size_t index, float textWidth) {
+    repeatCounts[textHandle[index]]++;
+    width[index] = textWidth;
+}
+
+std::pair<size_t, size_t> TextStore::band(float bandBottom, float bandTop, float maxTextHeight) const {
+    auto first = std::lower_bound(y.begin(), y.end(), bandBottom - maxTextHeight);
+    auto last = std::lower_bound(first, y.end(), bandTop);
+    return { static_cast<size_t>(first - y.begin()), static_cast<size_t>(last - y.begin()) };
+}
+
+void TextStore::clear() {
+    x.clear();
+    y.clear();
+    speed.clear();
+    width.clear();
+    height.clear();
+    category.clear();
+    palette.clear();
+    for (uint32_t handle : textHandle) layoutHandles[handle] = TextArena::INVALID_HANDLE;
+    textHandle.clear();
+    arena.clear();
+    glyphArena.clear();
+}
+
+// Moves the entry at from to index to (to < from), shifting the ones in
+// between up by one
+void TextStore::moveEntry(size_t from, size_t to) {
+    std::rotate(x.begin() + to, x.begin() + from, x.begin() + from + 1);
+    std::rotate(y.begin() + to, y.begin() + from, y.begin() + from + 1);
+    std::rotate(speed.begin() + to, speed.begin() + from, speed.begin() + from + 1);
+    std::rotate(width.begin() + to, width.begin() + from, width.begin() + from + 1);
+    std::rotate(height.begin() + to, height.begin() + from, height.begin() + from + 1);
+    std::rotate(category.begin() + to, category.begin() + from, category.begin() + from + 1);
+    std::rotate(palette.begin() + to, palette.begin() + from, palette.begin() + from + 1);
+    std::rotate(textHandle.begin() + to, textHandle.begin() + from, textHandle.begin() + from + 1);
+    for (size_t i = to; i <= from; i++) handleIndex[textHandle[i]] = static_cast<uint32_t>(i);
+}
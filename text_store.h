@@ -0,0 +1,224 @@
+#ifndef TEXT_STORE_H
+#define TEXT_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// What kind of line a text came from; decides its colour and whether
+// touching it hurts. Declared most severe first.
+enum class TextCategory : uint8_t {
+    Error,
+    Warning,
+    Note,
+    Progress,
+    Other
+};
+#define TEXT_CATEGORY_COUNT 5
+
+struct Color {
+    float r, g, b;
+};
+
+// Red errors, yellow warnings, cyan notes, grey progress, green everything else
+Color textCategoryColor(TextCategory category);
+
+// Axis-aligned box in pixel coords
+struct Aabb {
+    float minX, maxX;
+    float minY, maxY;
+};
+
+// Kernels over the position columns. Each has a scalar version and, on x86,
+// SSE2 and AVX2 versions picked once at startup from what the CPU supports;
+// all of them give bit-identical results.
+
+// y[i] -= speed[i] * deltaTime
+void integratePositions(float* y, const float* speed, size_t count, float deltaTime);
+
+// Length of the leading run of y values below limit. Stops at the first
+// value that isn't, so the cost is proportional to what gets culled.
+size_t countPrefixBelow(const float* y, size_t count, float limit);
+
+// Writes the indices (relative to the start of the arrays) of every box
+// overlapping box into hitIndices and returns how many there were.
+size_t collideAabb(const float* x, const float* y, const float* width, const float* height,
+                   size_t count, const Aabb& box, uint32_t* hitIndices);
+
+// Name of the kernel set in use ("avx2", "sse2" or "scalar")
+const char* textKernelName();
+
+// Forces the portable kernels, for benchmarking against the vector ones.
+void useScalarTextKernels(bool scalar);
+
+// Longest line kept for display; anything past this is far off screen
+#define MAX_TEXT_BYTES 1024
+#define DEFAULT_TEXT_CAPACITY 4096
+// Average glyphs cached per text; a long line only keeps the ones on screen
+#define LAYOUT_GLYPHS_PER_TEXT 64
+
+// One glyph of a laid-out text: what to draw, and where relative to the
+// text's left edge
+struct LayoutGlyph {
+    uint32_t codepoint;
+    float x;
+};
+
+// Fixed-size ring buffer holding the bytes of on-screen lines. Each stored
+// line gets a handle from a slot pool with a free list. Space is reclaimed
+// from the back of the ring up to the oldest line still live, so lines may
+// be released in any order, but one released ahead of older lines keeps
+// its bytes and its handle until they have all gone too: the arena suits
+// lines that mostly leave in the order they came. After construction it
+// never touches the heap.
+class TextArena {
+public:
+    static const uint32_t INVALID_HANDLE = 0xFFFFFFFFu;
+
+    TextArena(size_t byteCapacity, size_t maxLines);
+
+    // Copies bytes in and returns a handle, or INVALID_HANDLE if the ring or
+    // the slot pool is full. The record takes reserveBytes of the ring if
+    // that is more than it needs, for rewrite() to grow into. A handle is
+    // only reused once its line's space has been reclaimed.
+    uint32_t store(std::string_view bytes, size_t reserveBytes = 0);
+    // Replaces a record's bytes in place. Returns false (and leaves it as it
+    // was) if they don't fit the space it was stored with.
+    bool rewrite(uint32_t handle, std::string_view bytes);
+    // Releasing the newest record gives its space straight back
+    void release(uint32_t handle);
+    void clear();
+
+    std::string_view get(uint32_t handle) const {
+        const Slot& slot = slots[handle];
+        return std::string_view(bytes.data() + slot.offset, slot.length);
+    }
+
+    bool isLive(uint32_t handle) const { return slots[handle].live; }
+    size_t liveLines() const { return liveCount; }
+    size_t liveBytes() const { return liveByteCount; }
+
+private:
+    struct Slot {
+        uint32_t offset;
+        uint32_t length;
+        uint32_t reserved;  // ring bytes taken, at least length
+        bool live;
+    };
+
+    std::vector<char> bytes;
+    size_t head = 0;    // where the next line is written
+    size_t tail = 0;    // start of the oldest live line
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    // Handles in the order they were stored, as a ring
+    std::vector<uint32_t> storeOrder;
+    size_t orderHead = 0;
+    size_t orderCount = 0;
+    size_t liveCount = 0;
+    size_t liveByteCount = 0;
+};
+
+// Falling texts stored as a structure of arrays. The hot per-frame columns
+// are separate contiguous float arrays, and the line bytes sit off to the
+// side in a TextArena so the update and collision passes never touch them. Entries are kept
+// sorted by y (bottom of the screen first): texts that have fallen off are
+// always a prefix, and the texts level with any horizontal band form one
+// contiguous range.
+class TextStore {
+public:
+    // All storage is allocated here, sized for capacity texts averaging
+    // bytesPerText bytes; spawning and culling never allocate.
+    explicit TextStore(size_t capacity = DEFAULT_TEXT_CAPACITY, size_t bytesPerText = 256);
+
+    size_t size() const { return y.size(); }
+    bool empty() const { return y.empty(); }
+    size_t capacity() const { return maxTexts; }
+
+    std::string_view text(size_t index) const { return arena.get(textHandle[index]); }
+    // Lines this text stands for: 1, plus each repeat merged into it
+    uint32_t repeats(size_t index) const { return repeatCounts[textHandle[index]]; }
+    // Glyphs in the layouts of every text on screen: what a frame draws
+    size_t layoutGlyphCount() const { return glyphArena.liveBytes() / sizeof(LayoutGlyph); }
+
+    // Whether the text a handle was given to is still falling
+    bool isLive(uint32_t handle) const { return arena.isLive(handle); }
+    // Index of the live text with this handle, or size() if there is none
+    size_t find(uint32_t handle) const { return arena.isLive(handle) ? handleIndex[handle] : size(); }
+    // Counts one more line into the text at index, now textWidth wide
+    void addRepeat(size_t index, float textWidth);
+
+    // Replaces the layout a text spawned with, in the space kept for it:
+    // room for one glyph more than it had, which is what laying the same
+    // line out again to a nearer right edge can need (an ellipsis where
+    // there was none). Returns false, and the layout is unchanged, if the
+    // new one has more glyphs than that or the text has no layout.
+    bool setLayout(uint32_t handle, const LayoutGlyph* glyphs, size_t glyphCount);
+    // The layout of the text at index, if it has one
+    bool layout(size_t index, const LayoutGlyph*& glyphs, size_t& glyphCount) const {
+        uint32_t glyphHandle = layoutHandles[textHandle[index]];
+        if (glyphHandle == TextArena::INVALID_HANDLE) return false;
+        std::string_view bytes = glyphArena.get(glyphHandle);
+        glyphs = reinterpret_cast<const LayoutGlyph*>(bytes.data());
+        glyphCount = bytes.size() / sizeof(LayoutGlyph);
+        return true;
+    }
+
+    // Inserts a text at its place in the y order. Returns false (and counts
+    // a drop) if the store or one of its arenas is full. Lines longer than
+    // MAX_TEXT_BYTES are cut short. textPalette is the colour slot it is
+    // drawn with; the first TEXT_CATEGORY_COUNT slots are the category
+    // colours, in category order. glyphs, if given, is the layout it is
+    // drawn with, which skips decoding and measuring it every frame. The
+    // new text's handle goes to spawnedHandle if given.
+    bool spawn(std::string_view line, TextCategory textCategory, uint8_t textPalette, float textX, float textY,
+               float textSpeed, float textWidth, float textHeight, const LayoutGlyph* glyphs = nullptr,
+               size_t glyphCount = 0, uint32_t* spawnedHandle = nullptr);
+
+    uint64_t droppedSpawns() const { return drops; }
+
+    // Moves every text down by its speed, then restores the y order (a
+    // no-op pass when all texts fall at the same speed).
+    void integrate(float deltaTime);
+
+    // Drops texts whose y is below limit and returns how many went.
+    size_t removeBelow(float limit);
+
+    // Broadphase: the index range [first, second) of texts whose vertical
+    // extent can overlap [bandBottom, bandTop], given that no text is taller
+    // than maxTextHeight.
+    std::pair<size_t, size_t> band(float bandBottom, float bandTop, float maxTextHeight) const;
+
+    void clear();
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> speed;
+    std::vector<float> width;
+    std::vector<float> height;
+    std::vector<TextCategory> category;
+    std::vector<uint8_t> palette;
+    std::vector<uint32_t> textHandle;
+
+private:
+    void moveEntry(size_t from, size_t to);
+
+    size_t maxTexts;
+    TextArena arena;
+    // Every record stored is a whole number of LayoutGlyphs, so each one
+    // starts 8-byte aligned
+    TextArena glyphArena;
+    // Indexed by handle, so entries moving around never touch them
+    std::vector<uint32_t> repeatCounts;
+    std::vector<uint32_t> layoutHandles;
+    // Where each live handle's text is. Kept up to date as entries move:
+    // one at a time when sorting, all of them only when removeBelow()
+    // shifts the arrays anyway.
+    std::vector<uint32_t> handleIndex;
+    uint64_t drops = 0;
+};
+
+#endif
@@ -0,0 +1,267 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const char traceMagic[8] = { 'G', 'B', 'G', 'T', 'R', 'A', 'C', 'E' };
+// Version 1 had no lane table, version 2 no dedup flags or pattern hash
+static const uint8_t traceVersion = 3;
+
+static const char frameTag = 'F';
+static const char lineTag = 'L';
+
+static const uint8_t realTimeFlag = 1;
+static const uint8_t dedupFlag = 2;
+static const uint8_t dedupNormalizeFlag = 4;
+
+static const uint8_t moveLeftKey = 1;
+static const uint8_t moveRightKey = 2;
+
+static double nowUs() {
+    using Clock = std::chrono::steady_clock;
+    return std::chrono::duration<double, std::micro>(Clock::now().time_since_epoch()).count();
+}
+
+static uint8_t colorByte(float value) {
+    return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+bool TraceWriter::open(const std::string& path, const TraceSettings& settings, const std::vector<SourceLane>& lanes) {
+    close();
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to open trace " << path << " for writing" << std::endl;
+        return false;
+    }
+    // Records are small; a big buffer keeps recording to a few writes a second
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 16);
+
+    uint8_t flags = (settings.realTime ? realTimeFlag : 0) | (settings.dedup.enabled ? dedupFlag : 0) |
+                    (settings.dedup.normalize ? dedupNormalizeFlag : 0);
+    std::fwrite(traceMagic, sizeof(traceMagic), 1, file);
+    std::fputc(traceVersion, file);
+    std::fputc(flags, file);
+    std::fputc(static_cast<int>(lanes.size()), file);
+    for (const SourceLane& lane : lanes) {
+        std::fputc(static_cast<int>(lane.category), file);
+        std::fputc(colorByte(lane.color.r), file);
+        std::fputc(colorByte(lane.color.g), file);
+        std::fputc(colorByte(lane.color.b), file);
+        writeVarint(lane.weight);
+        writeVarint(lane.name.size());
+        std::fwrite(lane.name.data(), 1, lane.name.size(), file);
+    }
+    for (int shift = 0; shift < 64; shift += 8) {
+        std::fputc(static_cast<int>((settings.classifierHash >> shift) & 0xFF), file);
+    }
+    startUs = nowUs();
+    lastLineUs = 0;
+    frameCount = lineCount = 0;
+    return true;
+}
+
+void TraceWriter::close() {
+    if (!file) return;
+    if (std::fclose(file) != 0) {
+        std::cerr << "Failed to finish writing trace" << std::endl;
+    }
+    file = nullptr;
+}
+
+void TraceWriter::writeVarint(uint64_t value) {
+    while (value >= 0x80) {
+        std::fputc(static_cast<int>((value & 0x7F) | 0x80), file);
+        value >>= 7;
+    }
+    std::fputc(static_cast<int>(value), file);
+}
+
+void TraceWriter::frame(const SimInput& input) {
+    if (!file) return;
+    uint8_t keys = (input.moveLeft ? moveLeftKey : 0) | (input.moveRight ? moveRightKey : 0);
+    std::fputc(frameTag, file);
+    std::fwrite(&input.deltaTime, sizeof(input.deltaTime), 1, file);
+    std::fputc(keys, file);
+    frameCount++;
+}
+
+void TraceWriter::line(size_t lane, std::string_view text) {
+    if (!file) return;
+    uint64_t arrivalUs = static_cast<uint64_t>(nowUs() - startUs);
+    std::fputc(lineTag, file);
+    std::fputc(static_cast<int>(lane), file);
+    writeVarint(arrivalUs - std::min(arrivalUs, lastLineUs));
+    writeVarint(text.size());
+    std::fwrite(text.data(), 1, text.size(), file);
+    lastLineUs = arrivalUs;
+    lineCount++;
+}
+
+bool RecordingSource::nextLine(std::string_view& line) {
+    if (!inner.nextLine(line)) return false;
+    trace.line(traceLane, line);
+    return true;
+}
+
+bool ReplaySource::nextLine(std::string_view& line) {
+    if (next == pending.size()) return false;
+    line = std::string_view(data + pending[next].offset, pending[next].length);
+    next++;
+    return true;
+}
+
+bool TraceReader::open(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "Failed to open trace " << path << std::endl;
+        return false;
+    }
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    data = contents.str();
+
+    size_t headerBytes = sizeof(traceMagic) + 2;
+    uint8_t version = data.size() < headerBytes ? 0 : static_cast<uint8_t>(data[sizeof(traceMagic)]);
+    if (data.size() < headerBytes || std::memcmp(data.data(), traceMagic, sizeof(traceMagic)) != 0 ||
+        version < 1 || version > traceVersion) {
+        std::cerr << path << " is not a trace this version can read" << std::endl;
+        return false;
+    }
+    uint8_t flags = static_cast<uint8_t>(data[sizeof(traceMagic) + 1]);
+    traceSettings = TraceSettings();
+    traceSettings.realTime = (flags & realTimeFlag) != 0;
+    allSettings = version >= 3;
+    if (allSettings) {
+        traceSettings.dedup.enabled = (flags & dedupFlag) != 0;
+        traceSettings.dedup.normalize = (flags & dedupNormalizeFlag) != 0;
+    }
+
+    laneConfig.clear();
+    if (version == 1) {
+        laneConfig = { defaultSourceLane(0), defaultSourceLane(1) };
+        laneConfig[0].name = "red";
+        laneConfig[1].name = "green";
+    } else if (!readLaneTable(headerBytes)) {
+        std::cerr << path << " has a damaged lane table" << std::endl;
+        return false;
+    }
+    if (allSettings) {
+        if (headerBytes + 8 > data.size()) {
+            std::cerr << path << " has a damaged header" << std::endl;
+            return false;
+        }
+        for (int i = 0; i < 8; i++) {
+            uint64_t byte = static_cast<uint8_t>(data[headerBytes + i]);
+            traceSettings.classifierHash |= byte << (8 * i);
+        }
+        headerBytes += 8;
+    }
+    // Sized once: the lane configs point at these
+    lanes.assign(laneConfig.size(), ReplaySource());
+    for (size_t i = 0; i < lanes.size(); i++) {
+        lanes[i].data = data.data();
+        laneConfig[i].source = &lanes[i];
+    }
+
+    // One pass to count the frames, then back to the start
+    SimInput input;
+    cursor = headerBytes;
+    while (nextFrame(input)) {}
+    totalFrames = frameCount;
+    cursor = headerBytes;
+    frameCount = lineCount = 0;
+    return true;
+}
+
+bool TraceReader::applySettings(uint64_t classifierHash, DedupConfig& dedup) const {
+    if (!allSettings) return true;
+    if (traceSettings.classifierHash != classifierHash) {
+        std::cerr << "The trace was recorded with other classifier patterns; replay it with the --classify "
+                  << "(or none) it was recorded with" << std::endl;
+        return false;
+    }
+    dedup = traceSettings.dedup;
+    return true;
+}
+
+bool TraceReader::readLaneTable(size_t& offset) {
+    cursor = offset;
+    if (cursor >= data.size()) return false;
+    size_t count = static_cast<uint8_t>(data[cursor++]);
+    if (count == 0 || count > MAX_SOURCE_LANES) return false;
+    for (size_t i = 0; i < count; i++) {
+        if (cursor + 4 > data.size()) return false;
+        SourceLane lane;
+        uint8_t category = static_cast<uint8_t>(data[cursor]);
+        if (category >= TEXT_CATEGORY_COUNT) return false;
+        lane.category = static_cast<TextCategory>(category);
+        lane.color = { static_cast<uint8_t>(data[cursor + 1]) / 255.0f, static_cast<uint8_t>(data[cursor + 2]) / 255.0f,
+                       static_cast<uint8_t>(data[cursor + 3]) / 255.0f };
+        cursor += 4;
+        uint64_t weight, nameLength;
+        if (!readVarint(weight) || weight == 0 || !readVarint(nameLength) || nameLength > data.size() - cursor) {
+            return false;
+        }
+        lane.weight = static_cast<uint32_t>(weight);
+        lane.name = data.substr(cursor, nameLength);
+        cursor += nameLength;
+        laneConfig.push_back(lane);
+    }
+    offset = cursor;
+    return true;
+}
+
+bool TraceReader::readVarint(uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && cursor < data.size(); shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(data[cursor++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+bool TraceReader::nextFrame(SimInput& input) {
+    // Gather this frame's lines, up to the next frame record
+    for (ReplaySource& source : lanes) {
+        source.pending.clear();
+        source.next = 0;
+    }
+    bool haveFrame = false;
+    while (cursor < data.size()) {
+        char tag = data[cursor];
+        if (tag == frameTag) {
+            if (haveFrame) return true;
+            if (cursor + 1 + sizeof(float) + 1 > data.size()) break;
+            std::memcpy(&input.deltaTime, data.data() + cursor + 1, sizeof(float));
+            uint8_t keys = static_cast<uint8_t>(data[cursor + 1 + sizeof(float)]);
+            input.moveLeft = (keys & moveLeftKey) != 0;
+            input.moveRight = (keys & moveRightKey) != 0;
+            cursor += 1 + sizeof(float) + 1;
+            haveFrame = true;
+            frameCount++;
+        } else if (tag == lineTag) {
+            if (cursor + 2 > data.size()) break;
+            size_t lane = static_cast<uint8_t>(data[cursor + 1]);
+            cursor += 2;
+            uint64_t arrivalDelta, length;
+            if (!readVarint(arrivalDelta) || !readVarint(length) || length > data.size() - cursor) break;
+            if (lane < lanes.size()) {
+                lanes[lane].pending.push_back({ cursor, static_cast<size_t>(length) });
+            }
+            cursor += length;
+            lineCount++;
+        } else {
+            std::cerr << "Trace corrupt at byte " << cursor << std::endl;
+            cursor = data.size();
+            break;
+        }
+    }
+    // A recording cut short (the game killed mid-write) ends at its last
+    // whole record
+    return haveFrame;
+}
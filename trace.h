@@ -0,0 +1,136 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "log_reader.h"
+#include "simulation.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+// Everything that makes a session play out the way it did: each frame's
+// timestep and keys, and which lines the simulation took from each lane
+// during that frame, with the time they were taken. Replaying a trace
+// gives the simulation the same inputs step for step, whatever the clock
+// or the log files are doing now.
+//
+// The file is a short header with the settings below, a table of the lanes
+// (category, colour, weight and name of each), the classifier's pattern
+// hash, then records:
+//   'F' deltaTime(float) keys(u8)                   starts a frame
+//   'L' lane(u8) microsecondsSinceLast(varint) length(varint) bytes
+//
+// Settings that change what the same lines do travel with them, so a
+// replay doesn't depend on being given the same options again.
+struct TraceSettings {
+    bool realTime = false;        // the spawn mode the session ran with
+    DedupConfig dedup;
+    uint64_t classifierHash = 0;  // hashClassifierPatterns() of its patterns
+};
+
+class TraceWriter {
+public:
+    ~TraceWriter() { close(); }
+
+    // lanes are kept so a replay can classify and colour each lane's lines
+    // the same way
+    bool open(const std::string& path, const TraceSettings& settings, const std::vector<SourceLane>& lanes);
+    void close();
+    bool isOpen() const { return file != nullptr; }
+
+    void frame(const SimInput& input);
+    void line(size_t lane, std::string_view text);
+
+    uint64_t frames() const { return frameCount; }
+    uint64_t lines() const { return lineCount; }
+
+private:
+    void writeVarint(uint64_t value);
+
+    FILE* file = nullptr;
+    double startUs = 0.0;
+    uint64_t lastLineUs = 0;
+    uint64_t frameCount = 0;
+    uint64_t lineCount = 0;
+};
+
+// Passes lines through from another source, writing each one taken to a
+// trace
+class RecordingSource : public LineSource {
+public:
+    RecordingSource(LineSource& source, TraceWriter& writer, size_t lane)
+        : inner(source), trace(writer), traceLane(lane) {}
+
+    void poll() override { inner.poll(); }
+    bool nextLine(std::string_view& line) override;
+    int waitFd() const override { return inner.waitFd(); }
+    const char* watchPath() const override { return inner.watchPath(); }
+
+private:
+    LineSource& inner;
+    TraceWriter& trace;
+    size_t traceLane;
+};
+
+// Hands out one lane's lines for the frame being replayed. The views point
+// into the trace reader's copy of the file.
+class ReplaySource : public LineSource {
+public:
+    void poll() override {}
+    bool nextLine(std::string_view& line) override;
+
+private:
+    friend class TraceReader;
+
+    // Lines of the current frame, as offsets into the trace data
+    struct Pending {
+        size_t offset;
+        size_t length;
+    };
+    const char* data = nullptr;
+    std::vector<Pending> pending;
+    size_t next = 0;
+};
+
+// Reads a trace back one frame at a time. Each call to nextFrame() fills
+// in that frame's input and queues its lines on the lane sources, ready
+// for one Simulation::step. Traces from before lanes were recorded have
+// the two default lanes.
+class TraceReader {
+public:
+    bool open(const std::string& path);
+
+    const TraceSettings& settings() const { return traceSettings; }
+    // Traces from before dedup and the classifier were recorded only have
+    // the spawn mode; the rest of settings() is the defaults
+    bool hasAllSettings() const { return allSettings; }
+    // Replaces dedup with the recorded options, after checking the lines
+    // will be classified with the same patterns (classifierHash) as they
+    // were. Prints why and returns false if they won't be.
+    bool applySettings(uint64_t classifierHash, DedupConfig& dedup) const;
+    uint64_t frameTotal() const { return totalFrames; }
+    // The recorded lanes, each reading from this trace
+    const std::vector<SourceLane>& sourceLanes() const { return laneConfig; }
+
+    bool nextFrame(SimInput& input);
+
+    uint64_t frames() const { return frameCount; }
+    uint64_t lines() const { return lineCount; }
+
+private:
+    bool readVarint(uint64_t& value);
+
+    bool readLaneTable(size_t& offset);
+
+    std::string data;
+    size_t cursor = 0;
+    TraceSettings traceSettings;
+    bool allSettings = false;
+    uint64_t totalFrames = 0;
+    std::vector<ReplaySource> lanes;
+    std::vector<SourceLane> laneConfig;
+    uint64_t frameCount = 0;
+    uint64_t lineCount = 0;
+};
+
+#endif
@@ -0,0 +1,285 @@
+#include "build_process.h"
+#include "spawn_scheduler.h"
+#include "text_store.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <signal.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Checks for what a session can't be trusted to exercise: out-of-order
+// releases, wrap-around and overflow in the storage behind the game logic,
+// and build jobs that outlive their shell.
+// Run with make test; exits non-zero if any check fails.
+
+static int failures = 0;
+
+static void check(bool ok, const char* test, const std::string& what) {
+    if (ok) return;
+    failures++;
+    std::cerr << test << ": " << what << std::endl;
+}
+
+// Small deterministic generator, so a failure reproduces
+static uint32_t nextRandom(uint64_t& state) {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    return static_cast<uint32_t>(state >> 33);
+}
+
+static std::string makeLine(uint32_t id, size_t length) {
+    std::string line = std::to_string(id) + ":";
+    while (line.size() < length) line += static_cast<char>('a' + (id + line.size()) % 26);
+    line.resize(length);
+    return line;
+}
+
+// Releasing a newer line first must not let its handle, stored again,
+// pull the reclaim point past older lines that are still live
+static void testArenaOutOfOrderRelease() {
+    const char* test = "arena out-of-order release";
+    TextArena arena(48, 8);
+    uint32_t first = arena.store("first 0123");
+    uint32_t second = arena.store("second 012");
+    uint32_t third = arena.store("third 0123");
+    arena.release(second);
+    uint32_t fourth = arena.store("fourth 012");
+    arena.release(first);
+    // Only fits by wrapping over the first two lines and into the third
+    uint32_t fifth = arena.store("fifth, too long to fit 0");
+    check(arena.get(third) == "third 0123", test, "third line overwritten");
+    check(fourth != TextArena::INVALID_HANDLE && arena.get(fourth) == "fourth 012", test, "fourth line lost");
+    check(fifth == TextArena::INVALID_HANDLE, test, "fifth line stored over live bytes");
+}
+
+// Random stores and releases in random order against a copy of every live
+// line, checked after each operation
+static void testArenaRandomRelease() {
+    const char* test = "arena random release";
+    const size_t maxLines = 32;
+    TextArena arena(1024, maxLines);
+    std::vector<uint32_t> handles;
+    std::vector<std::string> expected;
+    uint64_t state = 1;
+    size_t stored = 0;
+    for (uint32_t op = 0; op < 200000 && failures == 0; op++) {
+        if (handles.empty() || nextRandom(state) % 3 != 0) {
+            std::string line = makeLine(op, nextRandom(state) % 80);
+            uint32_t handle = arena.store(line);
+            if (handle != TextArena::INVALID_HANDLE) {
+                handles.push_back(handle);
+                expected.push_back(line);
+                stored++;
+            }
+        } else {
+            size_t victim = nextRandom(state) % handles.size();
+            arena.release(handles[victim]);
+            handles[victim] = handles.back();
+            expected[victim] = expected.back();
+            handles.pop_back();
+            expected.pop_back();
+        }
+        for (size_t i = 0; i < handles.size(); i++) {
+            if (arena.get(handles[i]) != expected[i]) {
+                check(false, test, "line " + std::to_string(i) + " changed after operation " + std::to_string(op));
+                break;
+            }
+        }
+        check(arena.liveLines() == handles.size(), test, "live line count is off");
+    }
+    check(stored > 10000, test, "the arena stopped taking lines");
+}
+
+// Lines leave the backlog out of order: errors jump the queue, lanes take
+// weighted turns and overflow drops from the middle of the longest lane.
+// Every line spawned must still be the one pushed, and must stay intact
+// once it is falling among texts of mixed speeds.
+static void testSchedulerLinesIntact() {
+    const char* test = "scheduler lines intact";
+    SpawnConfig config;
+    config.realTime = true;
+    config.backlogLines = 16;
+    config.maxRate = 60.0f;
+    config.maxOnScreen = 64;
+    SpawnScheduler scheduler(config, { 1, 3, 2 });
+    TextStore texts(64, 64);
+    std::map<uint32_t, std::string> pushed;
+    std::vector<std::string> falling;
+    uint64_t state = 7;
+    uint32_t id = 0;
+    size_t spawned = 0;
+    double now = 0.0;
+    const float deltaTime = 1.0f / 60.0f;
+    for (int step = 0; step < 3000 && failures == 0; step++) {
+        now += deltaTime;
+        for (uint32_t burst = nextRandom(state) % 6; burst > 0; burst--) {
+            // A few run past MAX_TEXT_BYTES and are cut short
+            size_t length = 4 + nextRandom(state) % (nextRandom(state) % 10 == 0 ? 1500 : 120);
+            std::string line = makeLine(id, length);
+            TextCategory category = nextRandom(state) % 4 == 0 ? TextCategory::Error : TextCategory::Other;
+            scheduler.push(line, category, nextRandom(state) % 3, now);
+            pushed[id++] = line.substr(0, MAX_TEXT_BYTES);
+        }
+        scheduler.advance(now, deltaTime);
+
+        std::string_view line;
+        TextCategory category;
+        size_t lane;
+        while (scheduler.next(texts.size(), line, category, lane)) {
+            if (lane == NO_LANE) continue;
+            uint32_t lineId = static_cast<uint32_t>(std::stoul(std::string(line.substr(0, line.find(':')))));
+            auto it = pushed.find(lineId);
+            if (it == pushed.end() || it->second != line) {
+                check(false, test, "line " + std::to_string(lineId) + " spawned with another line's bytes");
+                break;
+            }
+            pushed.erase(it);
+            float speed = 40.0f + static_cast<float>(nextRandom(state) % 80);
+            if (texts.spawn(line, category, 0, 0.0f, 850.0f, speed, 10.0f, 10.0f)) spawned++;
+        }
+
+        texts.integrate(deltaTime);
+        texts.removeBelow(700.0f);
+        for (size_t i = 0; i < texts.size(); i++) {
+            std::string_view text = texts.text(i);
+            uint32_t lineId = static_cast<uint32_t>(std::stoul(std::string(text.substr(0, text.find(':')))));
+            if (text != makeLine(lineId, text.size())) {
+                check(false, test, "falling text " + std::to_string(lineId) + " changed");
+                break;
+            }
+            if (texts.find(texts.textHandle[i]) != i) {
+                check(false, test, "find() lost falling text " + std::to_string(lineId));
+                break;
+            }
+        }
+    }
+    const SpawnStats& stats = scheduler.stats();
+    check(spawned > 500, test, "too few lines spawned: " + std::to_string(spawned));
+    check(stats.droppedOverflow > 0, test, "the backlog never overflowed");
+}
+
+static std::vector<LayoutGlyph> makeLayout(uint32_t id, size_t count) {
+    std::vector<LayoutGlyph> glyphs(count);
+    for (size_t i = 0; i < count; i++) glyphs[i] = { id, static_cast<float>(i) };
+    return glyphs;
+}
+
+static bool layoutIs(const TextStore& texts, size_t index, uint32_t id, size_t count) {
+    const LayoutGlyph* glyphs;
+    size_t glyphCount;
+    if (!texts.layout(index, glyphs, glyphCount) || glyphCount != count) return false;
+    for (size_t i = 0; i < count; i++) {
+        if (glyphs[i].codepoint != id || glyphs[i].x != static_cast<float>(i)) return false;
+    }
+    return true;
+}
+
+// A text's layout is replaced where it was stored, never by storing it
+// again, and a text whose layout doesn't fit is not spawned
+static void testLayoutInPlace() {
+    const char* test = "layout in place";
+    // Room for 4 * LAYOUT_GLYPHS_PER_TEXT glyphs in all
+    TextStore texts(4, 64);
+    // The second text spawns below the first, so it is index 0 and leaves
+    // first
+    std::vector<LayoutGlyph> first = makeLayout(1, 10);
+    std::vector<LayoutGlyph> second = makeLayout(2, 20);
+    uint32_t firstHandle, secondHandle;
+    check(texts.spawn("first", TextCategory::Other, 0, 0.0f, 200.0f, 50.0f, 10.0f, 10.0f, first.data(), first.size(),
+                      &firstHandle),
+          test, "first text not spawned");
+    check(texts.spawn("second", TextCategory::Other, 0, 0.0f, 100.0f, 50.0f, 10.0f, 10.0f, second.data(),
+                      second.size(), &secondHandle),
+          test, "second text not spawned");
+
+    // One glyph more (an ellipsis) fits, two don't
+    std::vector<LayoutGlyph> longer = makeLayout(3, 11);
+    check(texts.setLayout(firstHandle, longer.data(), longer.size()), test, "ellipsis didn't fit");
+    check(layoutIs(texts, 1, 3, 11), test, "first layout not replaced");
+    std::vector<LayoutGlyph> tooLong = makeLayout(4, 12);
+    check(!texts.setLayout(firstHandle, tooLong.data(), tooLong.size()), test, "overlong layout accepted");
+    check(layoutIs(texts, 1, 3, 11), test, "failed replace changed the layout");
+    check(layoutIs(texts, 0, 2, 20), test, "second layout changed");
+    check(texts.layoutGlyphCount() == 31, test, "glyph count is off");
+
+    // More glyphs than the arena has left: the text isn't spawned at all
+    std::vector<LayoutGlyph> huge = makeLayout(5, 4 * LAYOUT_GLYPHS_PER_TEXT - 20);
+    check(!texts.spawn("huge", TextCategory::Other, 0, 0.0f, 300.0f, 50.0f, 10.0f, 10.0f, huge.data(), huge.size()),
+          test, "text spawned without room for its layout");
+    check(texts.size() == 2 && texts.droppedSpawns() == 1, test, "failed spawn not dropped");
+
+    // Out of order: the newer text leaves while the older one falls on,
+    // and its space and handle don't disturb the older layout
+    texts.removeBelow(150.0f);
+    check(texts.size() == 1 && layoutIs(texts, 0, 3, 11), test, "layout changed after a newer text left");
+    std::vector<LayoutGlyph> third = makeLayout(6, 30);
+    check(texts.spawn("third", TextCategory::Other, 0, 0.0f, 600.0f, 50.0f, 10.0f, 10.0f, third.data(), third.size()),
+          test, "third text not spawned");
+    check(layoutIs(texts, 0, 3, 11) && layoutIs(texts, 1, 6, 30), test, "layouts mixed up after reuse");
+}
+
+static bool groupGone(pid_t group) {
+    return kill(-group, 0) != 0 && errno == ESRCH;
+}
+
+// Updates the build until its shell has exited, for at most a few seconds
+static bool waitForShell(BuildProcess& build) {
+    for (int i = 0; i < 500 && build.running(); i++) {
+        build.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return !build.running();
+}
+
+// The shell exits at once, leaving a job behind in its group: stop() must
+// still take the job down
+static void testBuildStopLeavesNoJobs() {
+    const char* test = "build stop leaves no jobs";
+    BuildProcess build;
+    if (!build.start("sleep 30 & exit 0", 0.0)) {
+        check(false, test, "build not started");
+        return;
+    }
+    pid_t group = build.processGroup();
+    check(waitForShell(build), test, "shell didn't exit");
+    check(!groupGone(group), test, "job went with the shell");
+    build.stop();
+    check(build.processGroup() == -1 && groupGone(group), test, "job left running after stop()");
+}
+
+// A job that ignores SIGTERM and outlives its shell still goes once the
+// timeout's grace period is up
+static void testBuildTimeoutKillsJobs() {
+    const char* test = "build timeout kills jobs";
+    BuildProcess build;
+    if (!build.start("trap '' TERM; sleep 30 & exit 0", 0.1)) {
+        check(false, test, "build not started");
+        return;
+    }
+    pid_t group = build.processGroup();
+    check(waitForShell(build), test, "shell didn't exit");
+    for (int i = 0; i < 500 && build.processGroup() != -1; i++) {
+        build.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    check(build.processGroup() == -1 && groupGone(group), test, "job left running after the timeout");
+}
+
+int main() {
+    testArenaOutOfOrderRelease();
+    testArenaRandomRelease();
+    testSchedulerLinesIntact();
+    testLayoutInPlace();
+    testBuildStopLeavesNoJobs();
+    testBuildTimeoutKillsJobs();
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}